@@ -0,0 +1,153 @@
+/**
+	Benchmark of the parallel channels of the uniformly partitioned engines, see #UniformPartitionedKernel::forEachChannel.
+
+	Runs the per channel multiply accumulate of a partitioned engine for both channels of a block, once on the calling thread
+	alone and once forked onto a #ForkJoinPool, paced at real time: one callback of 256 samples per block period at 48 kHz,
+	with the thread sleeping in between like an audio thread. Prints the mean and 99th percentile time per callback and the speed up.
+
+	The worker only exists on machines with at least two cores, on a single core both runs are serial.
+
+	Not part of the plugin, built on its own, e.g.
+		g++ -O2 -std=c++14 -Isource/hpeq source/benchmarks/ChannelWorkerBenchmark.cpp source/hpeq/DSPKernels.cpp -lpthread -o ChannelWorkerBenchmark
+*/
+
+#include "DSPKernels.h"
+#include "AlignedAllocator.h"
+#include "ForkJoinPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	const unsigned int PartSize	 = 256;
+	const unsigned int BinStride = ((PartSize + 1) + 15) & ~15U;
+
+	const double SampleRate	  = 48000;
+	const double BlockPeriod  = PartSize / SampleRate;
+
+	const unsigned int NumPartitions[] = { 16, 64, 256, 1024 };
+
+	// callbacks per run, the first ones are dropped as warm up
+	const unsigned int NumCallbacks		  = 2000;
+	const unsigned int NumWarmUpCallbacks = 200;
+
+	/**
+		The frequency delay line of one channel, multiply accumulated like PartitionedKernel::accumulateSpectrum.
+	*/
+	struct Channel
+	{
+		Channel(unsigned int numPartitions) : numPartitions(numPartitions),
+			cacheRe(numPartitions * BinStride, 0.5f), cacheIm(numPartitions * BinStride, 0.25f),
+			kernelRe(numPartitions * BinStride, 0.3f), kernelIm(numPartitions * BinStride, -0.1f),
+			accRe(BinStride), accIm(BinStride)
+		{
+		}
+
+		void process()
+		{
+			auto & kernels = DSPKernels::get();
+
+			std::fill(accRe.begin(), accRe.end(), 0.f);
+			std::fill(accIm.begin(), accIm.end(), 0.f);
+
+			for (unsigned int p = 0; p < numPartitions; p++)
+			{
+				kernels.complexMultiplyAccumulate(cacheRe.data() + p * BinStride, cacheIm.data() + p * BinStride,
+					kernelRe.data() + p * BinStride, kernelIm.data() + p * BinStride, accRe.data(), accIm.data(), BinStride);
+			}
+
+			// fed back into the input, so the compiler can't drop the calls
+			cacheRe[0] += 1e-20f * accRe[7];
+		}
+
+		unsigned int numPartitions;
+		AlignedVector<float> cacheRe, cacheIm, kernelRe, kernelIm, accRe, accIm;
+	};
+
+	struct Result
+	{
+		double mean;
+		double p99;
+	};
+
+	/**
+		Calls @p callback once per block period and returns the time per call in microseconds.
+	*/
+	template<typename Function>
+	Result measurePaced(Function && callback)
+	{
+		using Clock = std::chrono::steady_clock;
+
+		auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(BlockPeriod));
+		auto next = Clock::now();
+
+		std::vector<double> times;
+		times.reserve(NumCallbacks);
+
+		for (unsigned int n = 0; n < NumCallbacks; n++)
+		{
+			std::this_thread::sleep_until(next);
+			next += period;
+
+			auto start = Clock::now();
+			callback();
+			double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+			if (n >= NumWarmUpCallbacks) times.push_back(1e6 * elapsed);
+		}
+
+		std::sort(times.begin(), times.end());
+
+		double sum = 0;
+		for (auto time : times) sum += time;
+
+		return { sum / times.size(), times[times.size() * 99 / 100] };
+	}
+}
+
+
+int main()
+{
+	std::unique_ptr<ForkJoinPool> pool;
+	if (std::thread::hardware_concurrency() >= 2) pool.reset(new ForkJoinPool(1, BlockPeriod));
+
+	std::printf("block of %u samples every %.2f ms, %s, time per callback in us\n", PartSize, 1e3 * BlockPeriod,
+		pool ? "one worker" : "single core, no worker");
+	std::printf("%10s %10s %10s %10s %10s %10s\n", "partitions", "serial", "p99", "parallel", "p99", "speed up");
+
+	for (auto numPartitions : NumPartitions)
+	{
+		Channel channels[2] = { Channel(numPartitions), Channel(numPartitions) };
+
+		auto processChannel = [&channels](unsigned int c) { channels[c].process(); };
+
+		auto serial = measurePaced([&]()
+		{
+			processChannel(0);
+			processChannel(1);
+		});
+
+		auto parallel = measurePaced([&]()
+		{
+			if (pool)
+			{
+				pool->run(2, processChannel);
+			}
+			else
+			{
+				processChannel(0);
+				processChannel(1);
+			}
+		});
+
+		std::printf("%10u %10.1f %10.1f %10.1f %10.1f %9.2fx\n", numPartitions, serial.mean, serial.p99, parallel.mean, parallel.p99,
+			serial.mean / parallel.mean);
+	}
+
+	return 0;
+}
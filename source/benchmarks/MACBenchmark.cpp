@@ -0,0 +1,156 @@
+/**
+	Benchmark of the frequency delay line multiply accumulate of #PartitionedKernel for 8 to 512 partitions.
+
+	Compares the former interleaved layout, one std::complex multiply per bin with a modulo per partition, against the split
+	layout walked by #PartitionedKernel::accumulateSpectrum on every instruction set of #DSPKernels the CPU supports.
+	Prints the time per block and channel.
+
+	Not part of the plugin, built on its own, e.g.
+		g++ -O2 -std=c++14 -Isource/hpeq source/benchmarks/MACBenchmark.cpp source/hpeq/DSPKernels.cpp -o MACBenchmark
+*/
+
+#include "DSPKernels.h"
+#include "AlignedAllocator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <complex>
+#include <cstdio>
+#include <vector>
+
+namespace
+{
+	const unsigned int PartSize = 256;
+	const unsigned int NumBins	= PartSize + 1;
+
+	// same padding as PartitionedKernel::binStride
+	const unsigned int BinStride = (NumBins + 15) & ~15U;
+
+	const unsigned int NumPartitions[] = { 8, 32, 128, 512 };
+
+	// minimum measured time per configuration in seconds
+	const double MinMeasurementTime = 0.3;
+
+	/**
+		Returns the time per call of @p function in microseconds.
+	*/
+	template<typename Function>
+	double measure(Function && function)
+	{
+		using Clock = std::chrono::steady_clock;
+
+		auto start = Clock::now();
+		unsigned int numCalls = 0;
+		double elapsed = 0;
+
+		do
+		{
+			function();
+			numCalls++;
+			elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+		} while (elapsed < MinMeasurementTime);
+
+		return 1e6 * elapsed / numCalls;
+	}
+
+	/**
+		The multiply accumulate before the split layout: interleaved bins and a modulo per partition.
+	*/
+	void interleavedMAC(const std::complex<float> * cache, const std::complex<float> * kernel, std::complex<float> * out,
+		unsigned int numPartitions, unsigned int currentPartition)
+	{
+		for (unsigned int i = 0; i < NumBins; i++)
+		{
+			out[i] = cache[currentPartition * NumBins + i] * kernel[i];
+		}
+
+		for (unsigned int p = 1; p < numPartitions; p++)
+		{
+			auto cacheOffset = NumBins * ((currentPartition + numPartitions - p) % numPartitions);
+
+			for (unsigned int i = 0; i < NumBins; i++)
+			{
+				out[i] += cache[cacheOffset + i] * kernel[NumBins * p + i];
+			}
+		}
+	}
+
+	/**
+		The multiply accumulate of PartitionedKernel::accumulateSpectrum on the selected kernels.
+	*/
+	void splitMAC(const AlignedVector<float> & cacheRe, const AlignedVector<float> & cacheIm,
+		const AlignedVector<float> & kernelRe, const AlignedVector<float> & kernelIm,
+		AlignedVector<float> & accRe, AlignedVector<float> & accIm, unsigned int numPartitions, unsigned int currentPartition)
+	{
+		auto & kernels = DSPKernels::get();
+
+		std::fill(accRe.begin(), accRe.end(), 0.f);
+		std::fill(accIm.begin(), accIm.end(), 0.f);
+
+		unsigned int cachePartition = currentPartition;
+		for (unsigned int p = 0; p < numPartitions; p++)
+		{
+			kernels.complexMultiplyAccumulate(cacheRe.data() + cachePartition * BinStride, cacheIm.data() + cachePartition * BinStride,
+				kernelRe.data() + p * BinStride, kernelIm.data() + p * BinStride, accRe.data(), accIm.data(), BinStride);
+
+			cachePartition = (cachePartition == 0) ? numPartitions - 1 : cachePartition - 1;
+		}
+	}
+}
+
+
+int main()
+{
+	using DSPKernels::InstructionSet;
+
+	auto supported = DSPKernels::getSupportedInstructionSet();
+
+	std::printf("partition size %u, time per block in us\n", PartSize);
+	std::printf("%10s %12s", "partitions", "interleaved");
+
+	for (auto instructionSet : { InstructionSet::Scalar, InstructionSet::SSE, InstructionSet::AVX, InstructionSet::AVX512 })
+	{
+		if (instructionSet <= supported) std::printf(" %12s", DSPKernels::getName(instructionSet));
+	}
+	std::printf("\n");
+
+	for (auto numPartitions : NumPartitions)
+	{
+		unsigned int currentPartition = 3 % numPartitions;
+
+		std::vector<std::complex<float>> cache(numPartitions * NumBins, { 0.5f, 0.25f });
+		std::vector<std::complex<float>> kernel(numPartitions * NumBins, { 0.3f, -0.1f });
+		std::vector<std::complex<float>> out(NumBins);
+
+		AlignedVector<float> cacheRe(numPartitions * BinStride, 0.5f), cacheIm(numPartitions * BinStride, 0.25f);
+		AlignedVector<float> kernelRe(numPartitions * BinStride, 0.3f), kernelIm(numPartitions * BinStride, -0.1f);
+		AlignedVector<float> accRe(BinStride), accIm(BinStride);
+
+		// the results are fed back into the input, so the compiler can't drop the calls
+		double interleavedTime = measure([&]()
+		{
+			interleavedMAC(cache.data(), kernel.data(), out.data(), numPartitions, currentPartition);
+			cache[0] += 1e-20f * out[7];
+		});
+
+		std::printf("%10u %12.2f", numPartitions, interleavedTime);
+
+		for (auto instructionSet : { InstructionSet::Scalar, InstructionSet::SSE, InstructionSet::AVX, InstructionSet::AVX512 })
+		{
+			if (instructionSet > supported) continue;
+
+			DSPKernels::selectInstructionSet(instructionSet);
+
+			double splitTime = measure([&]()
+			{
+				splitMAC(cacheRe, cacheIm, kernelRe, kernelIm, accRe, accIm, numPartitions, currentPartition);
+				cacheRe[0] += 1e-20f * accRe[7];
+			});
+
+			std::printf(" %6.2f (%3.1fx)", splitTime, interleavedTime / splitTime);
+		}
+		std::printf("\n");
+	}
+
+	return 0;
+}
@@ -33,8 +33,45 @@ public:
 
 	const ImpulseResponse * getImpulseResponse() const;
 
+	/**
+		Sets the maximum number of samples the host passes to #process per call, as announced in prepareToPlay.
+		Engines may align their block processing to it. May not be called from audio thread.
+		@param blockSize the host block size, 0 if unknown
+	*/
+	inline void setHostBlockSize(unsigned int blockSize);
+
+	/**
+		Called when the host block size was changed by #setHostBlockSize
+	*/
+	inline virtual void onHostBlockSizeUpdate() {};
+
+	/**
+		Returns the host block size, 0 if unknown
+	*/
+	unsigned int getHostBlockSize() const;
+
+	/**
+		Returns the number of samples the output is delayed by the engine, for the impulse response and configuration last set.
+		Zero latency engines don't need to override it.
+	*/
+	inline virtual unsigned int getLatencySamples() const { return 0; };
+
+	/**
+		Returns the number of samples the output keeps ringing after the input went silent, including the latency.
+		Defaults to the latency plus the impulse response size.
+	*/
+	inline virtual unsigned int getTailSamples() const;
+
+	/**
+		Frees engine data the audio thread replaced. Should be called regularly from a non time sensitive thread,
+		see #ThreadSyncable. Engines without swapped data don't need to override it.
+	*/
+	inline virtual void releaseRetired() {};
+
 private:
 	ImpulseResponse impulseResponse;
+
+	unsigned int hostBlockSize{ 0 };
 };
 
 void AConvolutionEngine::setImpulseResponse(const ImpulseResponse &impulseResponse)
@@ -47,3 +84,21 @@ inline const ImpulseResponse * AConvolutionEngine::getImpulseResponse() const
 {
 	return &impulseResponse;
 }
+
+inline void AConvolutionEngine::setHostBlockSize(unsigned int blockSize)
+{
+	if (blockSize == hostBlockSize) return;
+
+	this->hostBlockSize = blockSize;
+	onHostBlockSizeUpdate();
+}
+
+inline unsigned int AConvolutionEngine::getHostBlockSize() const
+{
+	return hostBlockSize;
+}
+
+inline unsigned int AConvolutionEngine::getTailSamples() const
+{
+	return getLatencySamples() + impulseResponse.getSize();
+}
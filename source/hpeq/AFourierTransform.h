@@ -43,12 +43,33 @@ public:
 	*/
 	virtual void performIFFTInPlace(std::complex<float> *buffer) = 0;
 
+	/**
+		Performs the fft of a real valued input. Only the non-negative frequency bins are calculated, the remaining bins
+		are the complex conjugates. The implementation is required to not block or dynamically allocate memory.
+		@param in  real input buffer of size 2^order
+		@param out output buffer of size 2^(order-1) + 1, see #getNumRealBins
+	*/
+	virtual void performRealFFT(const float *in, std::complex<float>* out) = 0;
+
+	/**
+		Performs the inverse fft of a conjugate symmetric spectrum with a real valued output. Only the non-negative
+		frequency bins are read. The implementation is required to not block or dynamically allocate memory.
+		@param in  input buffer of size 2^(order-1) + 1, see #getNumRealBins
+		@param out real output buffer of size 2^order
+	*/
+	virtual void performRealIFFT(const std::complex<float> *in, float* out) = 0;
+
 
 	/**
 		Returns the number of bins / samples supported by the FFT engine
 	*/
 	inline unsigned int getSize()  const { return size; }
 
+	/**
+		Returns the number of non-negative frequency bins used by the real valued transforms (size / 2 + 1)
+	*/
+	inline unsigned int getNumRealBins() const { return size / 2 + 1; }
+
 	/**
 		Returns the order of the FFT (where size = 2^order)
 	*/
@@ -10,6 +10,8 @@
 template<typename T>
 class ASyncedConvolutionEngine : public AConvolutionEngine
 {
+public:
+	virtual void releaseRetired() override final;
 
 protected:
 	/**
@@ -48,6 +50,12 @@ inline void ASyncedConvolutionEngine<T>::onImpulseResponseUpdate()
 	data.set(preProcess(*getImpulseResponse()));
 }
 
+template<typename T>
+inline void ASyncedConvolutionEngine<T>::releaseRetired()
+{
+	data.releaseRetired();
+}
+
 template<typename T>
 inline void ASyncedConvolutionEngine<T>::updateData()
 {
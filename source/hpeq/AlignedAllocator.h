@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+
+/**
+	A std::allocator replacement that aligns the storage to @p Alignment bytes, e.g. for SIMD loads and stores.
+	@param T the element type
+	@param Alignment the alignment in bytes, has to be a power of 2
+*/
+template<typename T, std::size_t Alignment = 64>
+struct AlignedAllocator
+{
+	static_assert((Alignment & (Alignment - 1)) == 0, "Alignment should be a power of two");
+
+	using value_type = T;
+
+	template<typename U>
+	struct rebind { using other = AlignedAllocator<U, Alignment>; };
+
+	AlignedAllocator() = default;
+
+	template<typename U>
+	AlignedAllocator(const AlignedAllocator<U, Alignment> &) {}
+
+	T * allocate(std::size_t n)
+	{
+		// over allocate and store the original pointer in front of the aligned block
+		void * raw = std::malloc(n * sizeof(T) + Alignment + sizeof(void*));
+		if (raw == nullptr) throw std::bad_alloc();
+
+		auto address = reinterpret_cast<std::uintptr_t>(raw) + sizeof(void*);
+		auto aligned = reinterpret_cast<void**>((address + Alignment - 1) & ~(Alignment - 1));
+		aligned[-1] = raw;
+
+		return reinterpret_cast<T*>(aligned);
+	}
+
+	void deallocate(T * p, std::size_t)
+	{
+		if (p != nullptr) std::free(reinterpret_cast<void**>(p)[-1]);
+	}
+};
+
+template<typename T, typename U, std::size_t Alignment>
+inline bool operator==(const AlignedAllocator<T, Alignment> &, const AlignedAllocator<U, Alignment> &) { return true; }
+
+template<typename T, typename U, std::size_t Alignment>
+inline bool operator!=(const AlignedAllocator<T, Alignment> &, const AlignedAllocator<U, Alignment> &) { return false; }
+
+/**
+	A std::vector with 64 byte aligned storage, enough for AVX-512 loads and stores.
+*/
+template<typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T, 64>>;
@@ -0,0 +1,691 @@
+#include "DSPKernels.h"
+
+#include <atomic>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+	#define HPEQ_X86 1
+	#include <immintrin.h>
+
+	// MSVC allows intrinsics of all instruction sets in every function, gcc and clang need the target per function
+	#if defined(_MSC_VER) && !defined(__clang__)
+		#include <intrin.h>
+		#define HPEQ_TARGET(isa)
+	#else
+		#define HPEQ_TARGET(isa) __attribute__((target(isa)))
+	#endif
+#endif
+
+// complete unrolling of the loops with compile time trip counts, MSVC does that on its own
+#if defined(__clang__)
+	#define HPEQ_UNROLL _Pragma("unroll")
+#elif defined(__GNUC__)
+	#define HPEQ_UNROLL _Pragma("GCC unroll 64")
+#else
+	#define HPEQ_UNROLL
+#endif
+
+
+namespace
+{
+	using namespace DSPKernels;
+
+	//==============================================================================
+	// scalar reference
+
+	void complexMultiplyAccumulateScalar(const float * aRe, const float * aIm, const float * bRe, const float * bIm, float * accRe, float * accIm, unsigned int n)
+	{
+		for (unsigned int i = 0; i < n; i++)
+		{
+			accRe[i] += aRe[i] * bRe[i] - aIm[i] * bIm[i];
+			accIm[i] += aRe[i] * bIm[i] + aIm[i] * bRe[i];
+		}
+	}
+
+	void multiplyAddScalar(float * dst, const float * src, float gain, unsigned int n)
+	{
+		for (unsigned int i = 0; i < n; i++)
+		{
+			dst[i] += gain * src[i];
+		}
+	}
+
+	float dotProductScalar(const float * a, const float * b, unsigned int n)
+	{
+		float sum = 0;
+		for (unsigned int i = 0; i < n; i++)
+		{
+			sum += a[i] * b[i];
+		}
+		return sum;
+	}
+
+	void firFilterScalar(const float * history, const float * reversedKernel, unsigned int kernelSize, float * out, unsigned int numSamples)
+	{
+		for (unsigned int i = 0; i < numSamples; i++)
+		{
+			out[i] = dotProductScalar(history + i, reversedKernel, kernelSize);
+		}
+	}
+
+	template<unsigned int KernelSize>
+	void firFilterFixedScalar(const float * history, const float * reversedKernel, unsigned int, float * out, unsigned int numSamples)
+	{
+		firFilterScalar(history, reversedKernel, KernelSize, out, numSamples);
+	}
+
+	void parallelSOSScalar(const float * b0, const float * b1, const float * b2, const float * a1, const float * a2,
+		float * z1, float * z2, unsigned int numSections, const float * in, float * out, unsigned int numSamples)
+	{
+		for (unsigned int i = 0; i < numSamples; i++)
+		{
+			float x = in[i];
+			float sum = 0;
+
+			for (unsigned int s = 0; s < numSections; s++)
+			{
+				float y = b0[s] * x + z1[s];
+				z1[s]	= b1[s] * x + z2[s] - a1[s] * y;
+				z2[s]	= b2[s] * x			- a2[s] * y;
+				sum += y;
+			}
+
+			out[i] += sum;
+		}
+	}
+
+#if HPEQ_X86
+
+	//==============================================================================
+	// SSE
+
+	HPEQ_TARGET("sse")
+	inline float horizontalSum(__m128 v)
+	{
+		__m128 shuffled = _mm_movehl_ps(v, v);
+		__m128 sums		= _mm_add_ps(v, shuffled);
+		shuffled		= _mm_shuffle_ps(sums, sums, 1);
+		return _mm_cvtss_f32(_mm_add_ss(sums, shuffled));
+	}
+
+	HPEQ_TARGET("sse")
+	void complexMultiplyAccumulateSSE(const float * aRe, const float * aIm, const float * bRe, const float * bIm, float * accRe, float * accIm, unsigned int n)
+	{
+		unsigned int numVectorized = n & ~3U;
+
+		for (unsigned int i = 0; i < numVectorized; i += 4)
+		{
+			__m128 ar = _mm_load_ps(aRe + i);
+			__m128 ai = _mm_load_ps(aIm + i);
+			__m128 br = _mm_load_ps(bRe + i);
+			__m128 bi = _mm_load_ps(bIm + i);
+
+			__m128 re = _mm_sub_ps(_mm_mul_ps(ar, br), _mm_mul_ps(ai, bi));
+			__m128 im = _mm_add_ps(_mm_mul_ps(ar, bi), _mm_mul_ps(ai, br));
+
+			_mm_store_ps(accRe + i, _mm_add_ps(_mm_load_ps(accRe + i), re));
+			_mm_store_ps(accIm + i, _mm_add_ps(_mm_load_ps(accIm + i), im));
+		}
+
+		complexMultiplyAccumulateScalar(aRe + numVectorized, aIm + numVectorized, bRe + numVectorized, bIm + numVectorized,
+			accRe + numVectorized, accIm + numVectorized, n - numVectorized);
+	}
+
+	HPEQ_TARGET("sse")
+	void multiplyAddSSE(float * dst, const float * src, float gain, unsigned int n)
+	{
+		unsigned int numVectorized = n & ~3U;
+		__m128 g = _mm_set1_ps(gain);
+
+		for (unsigned int i = 0; i < numVectorized; i += 4)
+		{
+			_mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(g, _mm_loadu_ps(src + i))));
+		}
+
+		multiplyAddScalar(dst + numVectorized, src + numVectorized, gain, n - numVectorized);
+	}
+
+	HPEQ_TARGET("sse")
+	float dotProductSSE(const float * a, const float * b, unsigned int n)
+	{
+		unsigned int numVectorized = n & ~3U;
+		__m128 sum = _mm_setzero_ps();
+
+		for (unsigned int i = 0; i < numVectorized; i += 4)
+		{
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+		}
+
+		return horizontalSum(sum) + dotProductScalar(a + numVectorized, b + numVectorized, n - numVectorized);
+	}
+
+	HPEQ_TARGET("sse")
+	void firFilterSSE(const float * history, const float * reversedKernel, unsigned int kernelSize, float * out, unsigned int numSamples)
+	{
+		unsigned int numBlocked = numSamples & ~3U;
+
+		// four outputs per pass share the kernel loads
+		for (unsigned int i = 0; i < numBlocked; i += 4)
+		{
+			const float * x = history + i;
+			__m128 sum0 = _mm_setzero_ps();
+			__m128 sum1 = _mm_setzero_ps();
+			__m128 sum2 = _mm_setzero_ps();
+			__m128 sum3 = _mm_setzero_ps();
+
+			for (unsigned int k = 0; k < kernelSize; k += 4)
+			{
+				__m128 h = _mm_load_ps(reversedKernel + k);
+				sum0 = _mm_add_ps(sum0, _mm_mul_ps(h, _mm_loadu_ps(x + k)));
+				sum1 = _mm_add_ps(sum1, _mm_mul_ps(h, _mm_loadu_ps(x + k + 1)));
+				sum2 = _mm_add_ps(sum2, _mm_mul_ps(h, _mm_loadu_ps(x + k + 2)));
+				sum3 = _mm_add_ps(sum3, _mm_mul_ps(h, _mm_loadu_ps(x + k + 3)));
+			}
+
+			out[i]	   = horizontalSum(sum0);
+			out[i + 1] = horizontalSum(sum1);
+			out[i + 2] = horizontalSum(sum2);
+			out[i + 3] = horizontalSum(sum3);
+		}
+
+		for (unsigned int i = numBlocked; i < numSamples; i++)
+		{
+			out[i] = dotProductSSE(history + i, reversedKernel, kernelSize);
+		}
+	}
+
+	template<unsigned int KernelSize>
+	HPEQ_TARGET("sse")
+	void firFilterFixedSSE(const float * history, const float * reversedKernel, unsigned int, float * out, unsigned int numSamples)
+	{
+		unsigned int numBlocked = numSamples & ~15U;
+
+		// the lanes run across 16 consecutive outputs, every tap is broadcast and no horizontal sums are needed
+		for (unsigned int i = 0; i < numBlocked; i += 16)
+		{
+			__m128 sum0 = _mm_setzero_ps();
+			__m128 sum1 = _mm_setzero_ps();
+			__m128 sum2 = _mm_setzero_ps();
+			__m128 sum3 = _mm_setzero_ps();
+
+			HPEQ_UNROLL
+			for (unsigned int k = 0; k < KernelSize; k++)
+			{
+				__m128 h = _mm_set1_ps(reversedKernel[k]);
+				const float * x = history + i + k;
+
+				sum0 = _mm_add_ps(sum0, _mm_mul_ps(h, _mm_loadu_ps(x)));
+				sum1 = _mm_add_ps(sum1, _mm_mul_ps(h, _mm_loadu_ps(x + 4)));
+				sum2 = _mm_add_ps(sum2, _mm_mul_ps(h, _mm_loadu_ps(x + 8)));
+				sum3 = _mm_add_ps(sum3, _mm_mul_ps(h, _mm_loadu_ps(x + 12)));
+			}
+
+			_mm_storeu_ps(out + i, sum0);
+			_mm_storeu_ps(out + i + 4, sum1);
+			_mm_storeu_ps(out + i + 8, sum2);
+			_mm_storeu_ps(out + i + 12, sum3);
+		}
+
+		for (unsigned int i = numBlocked; i < numSamples; i++)
+		{
+			out[i] = dotProductSSE(history + i, reversedKernel, KernelSize);
+		}
+	}
+
+	HPEQ_TARGET("sse")
+	void parallelSOSSSE(const float * b0, const float * b1, const float * b2, const float * a1, const float * a2,
+		float * z1, float * z2, unsigned int numSections, const float * in, float * out, unsigned int numSamples)
+	{
+		for (unsigned int i = 0; i < numSamples; i++)
+		{
+			__m128 x   = _mm_set1_ps(in[i]);
+			__m128 sum = _mm_setzero_ps();
+
+			for (unsigned int s = 0; s < numSections; s += 4)
+			{
+				__m128 y  = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(b0 + s), x), _mm_loadu_ps(z1 + s));
+				__m128 s1 = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(b1 + s), x), _mm_loadu_ps(z2 + s)), _mm_mul_ps(_mm_loadu_ps(a1 + s), y));
+				__m128 s2 = _mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(b2 + s), x), _mm_mul_ps(_mm_loadu_ps(a2 + s), y));
+
+				_mm_storeu_ps(z1 + s, s1);
+				_mm_storeu_ps(z2 + s, s2);
+				sum = _mm_add_ps(sum, y);
+			}
+
+			out[i] += horizontalSum(sum);
+		}
+	}
+
+	//==============================================================================
+	// AVX
+
+	HPEQ_TARGET("avx")
+	inline float horizontalSum(__m256 v)
+	{
+		__m128 sum = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+		__m128 shuffled = _mm_movehl_ps(sum, sum);
+		sum				= _mm_add_ps(sum, shuffled);
+		shuffled		= _mm_shuffle_ps(sum, sum, 1);
+		return _mm_cvtss_f32(_mm_add_ss(sum, shuffled));
+	}
+
+	HPEQ_TARGET("avx")
+	void complexMultiplyAccumulateAVX(const float * aRe, const float * aIm, const float * bRe, const float * bIm, float * accRe, float * accIm, unsigned int n)
+	{
+		unsigned int numVectorized = n & ~7U;
+
+		for (unsigned int i = 0; i < numVectorized; i += 8)
+		{
+			__m256 ar = _mm256_load_ps(aRe + i);
+			__m256 ai = _mm256_load_ps(aIm + i);
+			__m256 br = _mm256_load_ps(bRe + i);
+			__m256 bi = _mm256_load_ps(bIm + i);
+
+			__m256 re = _mm256_sub_ps(_mm256_mul_ps(ar, br), _mm256_mul_ps(ai, bi));
+			__m256 im = _mm256_add_ps(_mm256_mul_ps(ar, bi), _mm256_mul_ps(ai, br));
+
+			_mm256_store_ps(accRe + i, _mm256_add_ps(_mm256_load_ps(accRe + i), re));
+			_mm256_store_ps(accIm + i, _mm256_add_ps(_mm256_load_ps(accIm + i), im));
+		}
+
+		complexMultiplyAccumulateScalar(aRe + numVectorized, aIm + numVectorized, bRe + numVectorized, bIm + numVectorized,
+			accRe + numVectorized, accIm + numVectorized, n - numVectorized);
+	}
+
+	HPEQ_TARGET("avx")
+	void multiplyAddAVX(float * dst, const float * src, float gain, unsigned int n)
+	{
+		unsigned int numVectorized = n & ~7U;
+		__m256 g = _mm256_set1_ps(gain);
+
+		for (unsigned int i = 0; i < numVectorized; i += 8)
+		{
+			_mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(dst + i), _mm256_mul_ps(g, _mm256_loadu_ps(src + i))));
+		}
+
+		multiplyAddScalar(dst + numVectorized, src + numVectorized, gain, n - numVectorized);
+	}
+
+	HPEQ_TARGET("avx")
+	float dotProductAVX(const float * a, const float * b, unsigned int n)
+	{
+		unsigned int numVectorized = n & ~7U;
+		__m256 sum = _mm256_setzero_ps();
+
+		for (unsigned int i = 0; i < numVectorized; i += 8)
+		{
+			sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+		}
+
+		return horizontalSum(sum) + dotProductScalar(a + numVectorized, b + numVectorized, n - numVectorized);
+	}
+
+	HPEQ_TARGET("avx")
+	void firFilterAVX(const float * history, const float * reversedKernel, unsigned int kernelSize, float * out, unsigned int numSamples)
+	{
+		unsigned int numBlocked = numSamples & ~3U;
+
+		// four outputs per pass share the kernel loads
+		for (unsigned int i = 0; i < numBlocked; i += 4)
+		{
+			const float * x = history + i;
+			__m256 sum0 = _mm256_setzero_ps();
+			__m256 sum1 = _mm256_setzero_ps();
+			__m256 sum2 = _mm256_setzero_ps();
+			__m256 sum3 = _mm256_setzero_ps();
+
+			for (unsigned int k = 0; k < kernelSize; k += 8)
+			{
+				__m256 h = _mm256_load_ps(reversedKernel + k);
+				sum0 = _mm256_add_ps(sum0, _mm256_mul_ps(h, _mm256_loadu_ps(x + k)));
+				sum1 = _mm256_add_ps(sum1, _mm256_mul_ps(h, _mm256_loadu_ps(x + k + 1)));
+				sum2 = _mm256_add_ps(sum2, _mm256_mul_ps(h, _mm256_loadu_ps(x + k + 2)));
+				sum3 = _mm256_add_ps(sum3, _mm256_mul_ps(h, _mm256_loadu_ps(x + k + 3)));
+			}
+
+			out[i]	   = horizontalSum(sum0);
+			out[i + 1] = horizontalSum(sum1);
+			out[i + 2] = horizontalSum(sum2);
+			out[i + 3] = horizontalSum(sum3);
+		}
+
+		for (unsigned int i = numBlocked; i < numSamples; i++)
+		{
+			out[i] = dotProductAVX(history + i, reversedKernel, kernelSize);
+		}
+	}
+
+	template<unsigned int KernelSize>
+	HPEQ_TARGET("avx")
+	void firFilterFixedAVX(const float * history, const float * reversedKernel, unsigned int, float * out, unsigned int numSamples)
+	{
+		unsigned int numBlocked = numSamples & ~31U;
+
+		// the lanes run across 32 consecutive outputs, every tap is broadcast and no horizontal sums are needed
+		for (unsigned int i = 0; i < numBlocked; i += 32)
+		{
+			__m256 sum0 = _mm256_setzero_ps();
+			__m256 sum1 = _mm256_setzero_ps();
+			__m256 sum2 = _mm256_setzero_ps();
+			__m256 sum3 = _mm256_setzero_ps();
+
+			HPEQ_UNROLL
+			for (unsigned int k = 0; k < KernelSize; k++)
+			{
+				__m256 h = _mm256_set1_ps(reversedKernel[k]);
+				const float * x = history + i + k;
+
+				sum0 = _mm256_add_ps(sum0, _mm256_mul_ps(h, _mm256_loadu_ps(x)));
+				sum1 = _mm256_add_ps(sum1, _mm256_mul_ps(h, _mm256_loadu_ps(x + 8)));
+				sum2 = _mm256_add_ps(sum2, _mm256_mul_ps(h, _mm256_loadu_ps(x + 16)));
+				sum3 = _mm256_add_ps(sum3, _mm256_mul_ps(h, _mm256_loadu_ps(x + 24)));
+			}
+
+			_mm256_storeu_ps(out + i, sum0);
+			_mm256_storeu_ps(out + i + 8, sum1);
+			_mm256_storeu_ps(out + i + 16, sum2);
+			_mm256_storeu_ps(out + i + 24, sum3);
+		}
+
+		for (unsigned int i = numBlocked; i < numSamples; i++)
+		{
+			out[i] = dotProductAVX(history + i, reversedKernel, KernelSize);
+		}
+	}
+
+	HPEQ_TARGET("avx")
+	void parallelSOSAVX(const float * b0, const float * b1, const float * b2, const float * a1, const float * a2,
+		float * z1, float * z2, unsigned int numSections, const float * in, float * out, unsigned int numSamples)
+	{
+		for (unsigned int i = 0; i < numSamples; i++)
+		{
+			__m256 x   = _mm256_set1_ps(in[i]);
+			__m256 sum = _mm256_setzero_ps();
+
+			for (unsigned int s = 0; s < numSections; s += 8)
+			{
+				__m256 y  = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(b0 + s), x), _mm256_loadu_ps(z1 + s));
+				__m256 s1 = _mm256_sub_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(b1 + s), x), _mm256_loadu_ps(z2 + s)), _mm256_mul_ps(_mm256_loadu_ps(a1 + s), y));
+				__m256 s2 = _mm256_sub_ps(_mm256_mul_ps(_mm256_loadu_ps(b2 + s), x), _mm256_mul_ps(_mm256_loadu_ps(a2 + s), y));
+
+				_mm256_storeu_ps(z1 + s, s1);
+				_mm256_storeu_ps(z2 + s, s2);
+				sum = _mm256_add_ps(sum, y);
+			}
+
+			out[i] += horizontalSum(sum);
+		}
+	}
+
+	//==============================================================================
+	// AVX-512
+
+	HPEQ_TARGET("avx512f")
+	void complexMultiplyAccumulateAVX512(const float * aRe, const float * aIm, const float * bRe, const float * bIm, float * accRe, float * accIm, unsigned int n)
+	{
+		unsigned int numVectorized = n & ~15U;
+
+		for (unsigned int i = 0; i < numVectorized; i += 16)
+		{
+			__m512 ar = _mm512_load_ps(aRe + i);
+			__m512 ai = _mm512_load_ps(aIm + i);
+			__m512 br = _mm512_load_ps(bRe + i);
+			__m512 bi = _mm512_load_ps(bIm + i);
+
+			__m512 re = _mm512_sub_ps(_mm512_mul_ps(ar, br), _mm512_mul_ps(ai, bi));
+			__m512 im = _mm512_add_ps(_mm512_mul_ps(ar, bi), _mm512_mul_ps(ai, br));
+
+			_mm512_store_ps(accRe + i, _mm512_add_ps(_mm512_load_ps(accRe + i), re));
+			_mm512_store_ps(accIm + i, _mm512_add_ps(_mm512_load_ps(accIm + i), im));
+		}
+
+		complexMultiplyAccumulateScalar(aRe + numVectorized, aIm + numVectorized, bRe + numVectorized, bIm + numVectorized,
+			accRe + numVectorized, accIm + numVectorized, n - numVectorized);
+	}
+
+	HPEQ_TARGET("avx512f")
+	void multiplyAddAVX512(float * dst, const float * src, float gain, unsigned int n)
+	{
+		unsigned int numVectorized = n & ~15U;
+		__m512 g = _mm512_set1_ps(gain);
+
+		for (unsigned int i = 0; i < numVectorized; i += 16)
+		{
+			_mm512_storeu_ps(dst + i, _mm512_add_ps(_mm512_loadu_ps(dst + i), _mm512_mul_ps(g, _mm512_loadu_ps(src + i))));
+		}
+
+		multiplyAddScalar(dst + numVectorized, src + numVectorized, gain, n - numVectorized);
+	}
+
+	HPEQ_TARGET("avx512f")
+	float dotProductAVX512(const float * a, const float * b, unsigned int n)
+	{
+		unsigned int numVectorized = n & ~15U;
+		__m512 sum = _mm512_setzero_ps();
+
+		for (unsigned int i = 0; i < numVectorized; i += 16)
+		{
+			sum = _mm512_add_ps(sum, _mm512_mul_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i)));
+		}
+
+		return _mm512_reduce_add_ps(sum) + dotProductScalar(a + numVectorized, b + numVectorized, n - numVectorized);
+	}
+
+	HPEQ_TARGET("avx512f")
+	void firFilterAVX512(const float * history, const float * reversedKernel, unsigned int kernelSize, float * out, unsigned int numSamples)
+	{
+		unsigned int numBlocked = numSamples & ~3U;
+
+		// four outputs per pass share the kernel loads
+		for (unsigned int i = 0; i < numBlocked; i += 4)
+		{
+			const float * x = history + i;
+			__m512 sum0 = _mm512_setzero_ps();
+			__m512 sum1 = _mm512_setzero_ps();
+			__m512 sum2 = _mm512_setzero_ps();
+			__m512 sum3 = _mm512_setzero_ps();
+
+			for (unsigned int k = 0; k < kernelSize; k += 16)
+			{
+				__m512 h = _mm512_load_ps(reversedKernel + k);
+				sum0 = _mm512_add_ps(sum0, _mm512_mul_ps(h, _mm512_loadu_ps(x + k)));
+				sum1 = _mm512_add_ps(sum1, _mm512_mul_ps(h, _mm512_loadu_ps(x + k + 1)));
+				sum2 = _mm512_add_ps(sum2, _mm512_mul_ps(h, _mm512_loadu_ps(x + k + 2)));
+				sum3 = _mm512_add_ps(sum3, _mm512_mul_ps(h, _mm512_loadu_ps(x + k + 3)));
+			}
+
+			out[i]	   = _mm512_reduce_add_ps(sum0);
+			out[i + 1] = _mm512_reduce_add_ps(sum1);
+			out[i + 2] = _mm512_reduce_add_ps(sum2);
+			out[i + 3] = _mm512_reduce_add_ps(sum3);
+		}
+
+		for (unsigned int i = numBlocked; i < numSamples; i++)
+		{
+			out[i] = dotProductAVX512(history + i, reversedKernel, kernelSize);
+		}
+	}
+
+	template<unsigned int KernelSize>
+	HPEQ_TARGET("avx512f")
+	void firFilterFixedAVX512(const float * history, const float * reversedKernel, unsigned int, float * out, unsigned int numSamples)
+	{
+		unsigned int numBlocked = numSamples & ~63U;
+
+		// the lanes run across 64 consecutive outputs, every tap is broadcast and no horizontal sums are needed
+		for (unsigned int i = 0; i < numBlocked; i += 64)
+		{
+			__m512 sum0 = _mm512_setzero_ps();
+			__m512 sum1 = _mm512_setzero_ps();
+			__m512 sum2 = _mm512_setzero_ps();
+			__m512 sum3 = _mm512_setzero_ps();
+
+			HPEQ_UNROLL
+			for (unsigned int k = 0; k < KernelSize; k++)
+			{
+				__m512 h = _mm512_set1_ps(reversedKernel[k]);
+				const float * x = history + i + k;
+
+				sum0 = _mm512_add_ps(sum0, _mm512_mul_ps(h, _mm512_loadu_ps(x)));
+				sum1 = _mm512_add_ps(sum1, _mm512_mul_ps(h, _mm512_loadu_ps(x + 16)));
+				sum2 = _mm512_add_ps(sum2, _mm512_mul_ps(h, _mm512_loadu_ps(x + 32)));
+				sum3 = _mm512_add_ps(sum3, _mm512_mul_ps(h, _mm512_loadu_ps(x + 48)));
+			}
+
+			_mm512_storeu_ps(out + i, sum0);
+			_mm512_storeu_ps(out + i + 16, sum1);
+			_mm512_storeu_ps(out + i + 32, sum2);
+			_mm512_storeu_ps(out + i + 48, sum3);
+		}
+
+		for (unsigned int i = numBlocked; i < numSamples; i++)
+		{
+			out[i] = dotProductAVX512(history + i, reversedKernel, KernelSize);
+		}
+	}
+
+	HPEQ_TARGET("avx512f")
+	void parallelSOSAVX512(const float * b0, const float * b1, const float * b2, const float * a1, const float * a2,
+		float * z1, float * z2, unsigned int numSections, const float * in, float * out, unsigned int numSamples)
+	{
+		for (unsigned int i = 0; i < numSamples; i++)
+		{
+			__m512 x   = _mm512_set1_ps(in[i]);
+			__m512 sum = _mm512_setzero_ps();
+
+			for (unsigned int s = 0; s < numSections; s += 16)
+			{
+				__m512 y  = _mm512_add_ps(_mm512_mul_ps(_mm512_loadu_ps(b0 + s), x), _mm512_loadu_ps(z1 + s));
+				__m512 s1 = _mm512_sub_ps(_mm512_add_ps(_mm512_mul_ps(_mm512_loadu_ps(b1 + s), x), _mm512_loadu_ps(z2 + s)), _mm512_mul_ps(_mm512_loadu_ps(a1 + s), y));
+				__m512 s2 = _mm512_sub_ps(_mm512_mul_ps(_mm512_loadu_ps(b2 + s), x), _mm512_mul_ps(_mm512_loadu_ps(a2 + s), y));
+
+				_mm512_storeu_ps(z1 + s, s1);
+				_mm512_storeu_ps(z2 + s, s2);
+				sum = _mm512_add_ps(sum, y);
+			}
+
+			out[i] += _mm512_reduce_add_ps(sum);
+		}
+	}
+
+#endif
+
+	//==============================================================================
+
+	const KernelTable scalarKernels{ InstructionSet::Scalar, complexMultiplyAccumulateScalar, multiplyAddScalar, dotProductScalar, firFilterScalar, parallelSOSScalar,
+		{ firFilterFixedScalar<32>, firFilterFixedScalar<64>, firFilterFixedScalar<128>, firFilterFixedScalar<256> } };
+
+#if HPEQ_X86
+	const KernelTable sseKernels	{ InstructionSet::SSE,	  complexMultiplyAccumulateSSE,	   multiplyAddSSE,	  dotProductSSE,	 firFilterSSE,	  parallelSOSSSE,
+		{ firFilterFixedSSE<32>, firFilterFixedSSE<64>, firFilterFixedSSE<128>, firFilterFixedSSE<256> } };
+
+	const KernelTable avxKernels	{ InstructionSet::AVX,	  complexMultiplyAccumulateAVX,	   multiplyAddAVX,	  dotProductAVX,	 firFilterAVX,	  parallelSOSAVX,
+		{ firFilterFixedAVX<32>, firFilterFixedAVX<64>, firFilterFixedAVX<128>, firFilterFixedAVX<256> } };
+
+	const KernelTable avx512Kernels { InstructionSet::AVX512, complexMultiplyAccumulateAVX512, multiplyAddAVX512, dotProductAVX512, firFilterAVX512, parallelSOSAVX512,
+		{ firFilterFixedAVX512<32>, firFilterFixedAVX512<64>, firFilterFixedAVX512<128>, firFilterFixedAVX512<256> } };
+#endif
+
+	const KernelTable & getKernels(InstructionSet instructionSet)
+	{
+		switch (instructionSet)
+		{
+#if HPEQ_X86
+		case InstructionSet::AVX512: return avx512Kernels;
+		case InstructionSet::AVX:	 return avxKernels;
+		case InstructionSet::SSE:	 return sseKernels;
+#endif
+		default:					 return scalarKernels;
+		}
+	}
+
+	InstructionSet detectInstructionSet()
+	{
+#if HPEQ_X86
+	#if defined(_MSC_VER) && !defined(__clang__)
+		int info[4];
+		__cpuid(info, 0);
+		int maxLeaf = info[0];
+
+		__cpuid(info, 1);
+		bool sse	 = (info[3] & (1 << 25)) != 0;
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		bool avx	 = (info[2] & (1 << 28)) != 0;
+
+		bool avx512f = false;
+		if (maxLeaf >= 7)
+		{
+			__cpuidex(info, 7, 0);
+			avx512f = (info[1] & (1 << 16)) != 0;
+		}
+
+		// the OS has to save the ymm / zmm registers on context switches
+		unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+		avx		= avx	  && ((xcr0 & 0x06) == 0x06);
+		avx512f = avx512f && avx && ((xcr0 & 0xE6) == 0xE6);
+	#else
+		// also checks for OS support of the ymm / zmm registers
+		__builtin_cpu_init();
+		bool sse	 = __builtin_cpu_supports("sse");
+		bool avx	 = __builtin_cpu_supports("avx");
+		bool avx512f = __builtin_cpu_supports("avx512f");
+	#endif
+
+		if (avx512f) return InstructionSet::AVX512;
+		if (avx)	 return InstructionSet::AVX;
+		if (sse)	 return InstructionSet::SSE;
+#endif
+		return InstructionSet::Scalar;
+	}
+
+	std::atomic<const KernelTable*> selectedKernels{ nullptr };
+}
+
+const DSPKernels::KernelTable & DSPKernels::get()
+{
+	auto kernels = selectedKernels.load(std::memory_order_acquire);
+
+	if (kernels == nullptr)
+	{
+		// concurrent first calls select the same table, no need to synchronize further
+		kernels = &getKernels(getSupportedInstructionSet());
+		selectedKernels.store(kernels, std::memory_order_release);
+	}
+
+	return *kernels;
+}
+
+const DSPKernels::KernelTable & DSPKernels::getScalar()
+{
+	return scalarKernels;
+}
+
+DSPKernels::InstructionSet DSPKernels::getSupportedInstructionSet()
+{
+	static const InstructionSet supported = detectInstructionSet();
+	return supported;
+}
+
+DSPKernels::InstructionSet DSPKernels::getSelectedInstructionSet()
+{
+	return get().instructionSet;
+}
+
+DSPKernels::InstructionSet DSPKernels::selectInstructionSet(InstructionSet instructionSet)
+{
+	instructionSet = std::min(instructionSet, getSupportedInstructionSet());
+	selectedKernels.store(&getKernels(instructionSet), std::memory_order_release);
+	return instructionSet;
+}
+
+const char * DSPKernels::getName(InstructionSet instructionSet)
+{
+	switch (instructionSet)
+	{
+	case InstructionSet::Scalar: return "Scalar";
+	case InstructionSet::SSE:	 return "SSE";
+	case InstructionSet::AVX:	 return "AVX";
+	case InstructionSet::AVX512: return "AVX-512";
+	}
+	return "Unknown";
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+
+/**
+	The hot loops of the convolution engines and impulse response tools with implementations for several instruction sets.
+
+	The best implementation for the current CPU is selected at runtime on first use, so one binary runs on every x86 CPU
+	and still uses AVX / AVX-512 where available. The scalar implementations are always available as a reference for verification.
+
+	Kernels working on spectra expect a split layout (real and imaginary parts in seperate arrays) aligned to 64 bytes, see #AlignedVector.
+	All other kernels work on unaligned data.
+*/
+namespace DSPKernels
+{
+	/**
+		Signature of the direct form FIR kernels, see #KernelTable::firFilter.
+	*/
+	using FIRFilterFunction = void (*)(const float * history, const float * reversedKernel, unsigned int kernelSize, float * out, unsigned int numSamples);
+
+	/**
+		Kernel sizes with a compile time specialized FIR kernel, see #KernelTable::getFIRFilter.
+	*/
+	const unsigned int FixedFIRSizes[] = { 32, 64, 128, 256 };
+	const unsigned int NumFixedFIRSizes = 4;
+
+	/**
+		Instruction sets with dedicated kernel implementations, ordered by capability.
+	*/
+	enum class InstructionSet
+	{
+		Scalar,
+		SSE,
+		AVX,
+		AVX512
+	};
+
+	/**
+		A table of kernel implementations for one instruction set.
+	*/
+	struct KernelTable
+	{
+		InstructionSet instructionSet;
+
+		/**
+			Calculates acc += a * b for @p n complex bins in split layout.
+			@param aRe, aIm real and imaginary parts of the first factor
+			@param bRe, bIm real and imaginary parts of the second factor
+			@param accRe, accIm real and imaginary parts of the accumulator
+			@param n number of bins
+		*/
+		void (*complexMultiplyAccumulate)(const float * aRe, const float * aIm, const float * bRe, const float * bIm, float * accRe, float * accIm, unsigned int n);
+
+		/**
+			Calculates dst += gain * src for @p n samples.
+		*/
+		void (*multiplyAdd)(float * dst, const float * src, float gain, unsigned int n);
+
+		/**
+			Returns the dot product of @p a and @p b with @p n samples.
+		*/
+		float (*dotProduct)(const float * a, const float * b, unsigned int n);
+
+		/**
+			Direct form FIR filter in gather form: out[i] = dot(history + i, reversedKernel) for @p numSamples outputs.
+			Several outputs are computed per pass so every kernel load is shared.
+			@param history the input samples, numSamples + kernelSize - 1 of them, oldest first
+			@param reversedKernel the time reversed filter kernel, aligned to 64 bytes
+			@param kernelSize the kernel size, has to be a multiple of 16
+			@param out the output samples
+			@param numSamples the number of output samples
+		*/
+		FIRFilterFunction firFilter;
+
+		/**
+			Processes a bank of parallel second order sections (transposed direct form II) in structure of arrays layout.
+			All sections share the input, their outputs are added to @p out.
+			@param b0, b1, b2, a1, a2 the coefficients, one per section
+			@param z1, z2 the filter states, one per section
+			@param numSections the number of sections, has to be a multiple of 16
+			@param in the input samples
+			@param out the output samples the bank output is added to
+			@param numSamples the number of samples
+		*/
+		void (*parallelSOS)(const float * b0, const float * b1, const float * b2, const float * a1, const float * a2,
+			float * z1, float * z2, unsigned int numSections, const float * in, float * out, unsigned int numSamples);
+
+		/**
+			#firFilter specialized at compile time for the kernel sizes in #FixedFIRSizes. The tap loop is fully unrolled and
+			the SIMD lanes run across outputs instead of taps, which saves the horizontal sums. The kernelSize argument is ignored.
+		*/
+		FIRFilterFunction firFilterFixed[NumFixedFIRSizes];
+
+		/**
+			Returns the specialized FIR kernel if there is one for @p kernelSize, #firFilter otherwise.
+		*/
+		inline FIRFilterFunction getFIRFilter(unsigned int kernelSize) const
+		{
+			for (unsigned int i = 0; i < NumFixedFIRSizes; i++)
+			{
+				if (FixedFIRSizes[i] == kernelSize) return firFilterFixed[i];
+			}
+			return firFilter;
+		}
+	};
+
+	/**
+		Returns the kernels selected for the current CPU. Thread safe, the selection is done on the first call.
+	*/
+	const KernelTable & get();
+
+	/**
+		Returns the scalar reference kernels.
+	*/
+	const KernelTable & getScalar();
+
+	/**
+		Returns the best instruction set supported by the CPU and OS.
+	*/
+	InstructionSet getSupportedInstructionSet();
+
+	/**
+		Returns the instruction set of the kernels returned by #get.
+	*/
+	InstructionSet getSelectedInstructionSet();
+
+	/**
+		Overrides the selected kernels, e.g. to verify against the scalar reference. Instruction sets the CPU doesn't
+		support are clamped to the best supported one.
+		@param instructionSet the requested instruction set
+		@return the instruction set actually selected
+	*/
+	InstructionSet selectInstructionSet(InstructionSet instructionSet);
+
+	/**
+		Returns a readable name of the instruction set for diagnostics.
+	*/
+	const char * getName(InstructionSet instructionSet);
+};
@@ -0,0 +1,339 @@
+#include "EngineCostModel.h"
+
+#include "TimeDomainConvolution.h"
+#include "FFTConvolution.h"
+#include "FFTPartConvolution.h"
+#include "FFTNonUniformConvolution.h"
+#include "DSPKernels.h"
+#include "IRTools.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <random>
+
+namespace
+{
+	const int CalibrationFileVersion = 2;
+
+	// the measurement grid
+	const unsigned int CalibrationBlockSizes[] = { 64, 256, 1024 };
+	const unsigned int CalibrationIRSizes[]	   = { 64, 256, 1024, 4096, 16384, 65536 };
+
+	// above, the time domain engine is far off and only extrapolated
+	const unsigned int MaxTimeDomainIRSize = 4096;
+
+	// smallest partition size of the FFT engines, see FFTPartConvolution::MinOrder
+	const unsigned int MinPartSize = 16;
+
+	// minimum time measured per configuration, short measurements are repeated up to this time
+	const double MinMeasurementTime = 0.005;
+
+	const char * getEngineName(EngineCostModel::EngineType engine)
+	{
+		switch (engine)
+		{
+		case EngineCostModel::EngineType::TimeDomain:	  return "TimeDomain";
+		case EngineCostModel::EngineType::FFTBrute:		  return "FFTBrute";
+		case EngineCostModel::EngineType::FFTPartitioned: return "FFTPartitioned";
+		case EngineCostModel::EngineType::FFTNonUniform:  return "FFTNonUniform";
+		}
+		return "";
+	}
+
+	unsigned int getLog2Distance(unsigned int a, unsigned int b)
+	{
+		int la = IRTools::staticLog2(a);
+		int lb = IRTools::staticLog2(b);
+		return static_cast<unsigned int>(std::abs(la - lb));
+	}
+}
+
+
+void EngineCostModel::calibrate(bool parallelChannels, const std::atomic<bool> * shouldCancel)
+{
+	measurements.clear();
+	this->parallelChannels = parallelChannels;
+
+	auto add = [this, parallelChannels](EngineType engine, unsigned int partSize, unsigned int irSize, unsigned int blockSize)
+	{
+		measurements.push_back({ engine, partSize, irSize, blockSize, measure(engine, partSize, irSize, blockSize, parallelChannels) });
+	};
+
+	for (auto blockSize : CalibrationBlockSizes)
+	{
+		for (auto irSize : CalibrationIRSizes)
+		{
+			if (shouldCancel && shouldCancel->load())
+			{
+				measurements.clear();
+				return;
+			}
+
+			if (irSize <= MaxTimeDomainIRSize)
+			{
+				add(EngineType::TimeDomain, 0, irSize, blockSize);
+			}
+
+			add(EngineType::FFTBrute, 0, irSize, blockSize);
+			add(EngineType::FFTNonUniform, 0, irSize, blockSize);
+
+			for (unsigned int partSize = MinPartSize; partSize <= irSize / 2; partSize *= 2)
+			{
+				add(EngineType::FFTPartitioned, partSize, irSize, blockSize);
+			}
+		}
+	}
+}
+
+bool EngineCostModel::load(const std::string & path, bool parallelChannels)
+{
+	std::ifstream file(path);
+	if (!file) return false;
+
+	std::string header, instructionSet;
+	int version = 0;
+	int parallel = 0;
+	unsigned int numMeasurements = 0;
+
+	file >> header >> version >> instructionSet >> parallel >> numMeasurements;
+
+	// measurements of another instruction set don't tell anything about the current kernels
+	if (!file || header != "hpeq-engine-calibration" || version != CalibrationFileVersion) return false;
+	if (instructionSet != DSPKernels::getName(DSPKernels::get().instructionSet)) return false;
+	if ((parallel != 0) != parallelChannels) return false;
+
+	std::vector<Measurement> loaded;
+
+	for (unsigned int i = 0; i < numMeasurements; i++)
+	{
+		std::string engineName;
+		Measurement measurement;
+
+		file >> engineName >> measurement.partSize >> measurement.irSize >> measurement.blockSize >> measurement.cost;
+		if (!file) return false;
+
+		bool known = false;
+		for (auto engine : { EngineType::TimeDomain, EngineType::FFTBrute, EngineType::FFTPartitioned, EngineType::FFTNonUniform })
+		{
+			if (engineName == getEngineName(engine))
+			{
+				measurement.engine = engine;
+				known = true;
+			}
+		}
+
+		if (!known) return false;
+
+		loaded.push_back(measurement);
+	}
+
+	measurements = std::move(loaded);
+	this->parallelChannels = parallelChannels;
+	return true;
+}
+
+bool EngineCostModel::save(const std::string & path) const
+{
+	std::ofstream file(path);
+	if (!file) return false;
+
+	file << "hpeq-engine-calibration " << CalibrationFileVersion << "\n";
+	file << DSPKernels::getName(DSPKernels::get().instructionSet) << "\n";
+	file << (parallelChannels ? 1 : 0) << "\n";
+	file << measurements.size() << "\n";
+
+	file.precision(9);
+	for (auto & measurement : measurements)
+	{
+		file << getEngineName(measurement.engine) << " " << measurement.partSize << " " << measurement.irSize << " "
+			 << measurement.blockSize << " " << measurement.cost << "\n";
+	}
+
+	return static_cast<bool>(file);
+}
+
+bool EngineCostModel::isCalibrated() const
+{
+	return !measurements.empty();
+}
+
+bool EngineCostModel::hasParallelChannels() const
+{
+	return parallelChannels;
+}
+
+double EngineCostModel::estimateCost(EngineType engine, unsigned int partSize, unsigned int irSize, unsigned int blockSize) const
+{
+	if (engine != EngineType::FFTPartitioned) partSize = 0;
+
+	// the closest measured block size
+	unsigned int gridBlockSize = 0;
+	for (auto & measurement : measurements)
+	{
+		if (measurement.engine != engine || measurement.partSize != partSize) continue;
+
+		if (gridBlockSize == 0 || getLog2Distance(measurement.blockSize, blockSize) < getLog2Distance(gridBlockSize, blockSize))
+		{
+			gridBlockSize = measurement.blockSize;
+		}
+	}
+
+	std::vector<std::pair<double, double>> points;
+	for (auto & measurement : measurements)
+	{
+		if (measurement.engine == engine && measurement.partSize == partSize && measurement.blockSize == gridBlockSize)
+		{
+			points.push_back({ std::log(static_cast<double>(measurement.irSize)), std::log(std::max(measurement.cost, 1e-15)) });
+		}
+	}
+
+	if (points.empty()) return std::numeric_limits<double>::infinity();
+	if (points.size() == 1) return std::exp(points[0].second);
+
+	std::sort(points.begin(), points.end());
+
+	// log-log interpolation between the enclosing grid points, extrapolation with the first or last two
+	double x = std::log(static_cast<double>(std::max(irSize, 1U)));
+
+	unsigned int upper = 1;
+	while (upper + 1 < points.size() && points[upper].first < x) upper++;
+
+	auto & p0 = points[upper - 1];
+	auto & p1 = points[upper];
+
+	double y = p0.second + (p1.second - p0.second) * (x - p0.first) / (p1.first - p0.first);
+	return std::exp(y);
+}
+
+EngineCostModel::Choice EngineCostModel::select(unsigned int irSize, unsigned int blockSize, unsigned int maxLatency) const
+{
+	std::vector<Choice> candidates;
+
+	for (auto engine : { EngineType::TimeDomain, EngineType::FFTBrute, EngineType::FFTNonUniform })
+	{
+		Choice choice;
+		choice.engine = engine;
+		candidates.push_back(choice);
+	}
+
+	for (unsigned int partSize = MinPartSize; partSize <= IRTools::nextPow2(irSize) / 2; partSize *= 2)
+	{
+		Choice choice;
+		choice.engine			 = EngineType::FFTPartitioned;
+		choice.partSize			 = partSize;
+		choice.partitioningOrder = getPartitioningOrder(partSize, irSize);
+		candidates.push_back(choice);
+	}
+
+	// without measurements all costs are infinite and the default, the zero latency non uniform engine, is returned
+	Choice best;
+	best.cost = std::numeric_limits<double>::infinity();
+
+	for (auto & choice : candidates)
+	{
+		choice.latency = getLatency(choice.engine, choice.partSize, irSize);
+		if (choice.latency > maxLatency) continue;
+
+		choice.cost = estimateCost(choice.engine, choice.partSize, irSize, blockSize);
+		if (choice.cost < best.cost) best = choice;
+	}
+
+	return best;
+}
+
+unsigned int EngineCostModel::getLatency(EngineType engine, unsigned int partSize, unsigned int irSize)
+{
+	switch (engine)
+	{
+	case EngineType::TimeDomain:	 return 0;
+	case EngineType::FFTNonUniform:	 return 0;
+	case EngineType::FFTBrute:		 return std::max(IRTools::nextPow2(irSize), MinPartSize);
+	case EngineType::FFTPartitioned: return std::max(partSize, MinPartSize);
+	}
+	return 0;
+}
+
+std::unique_ptr<AConvolutionEngine> EngineCostModel::createEngine(EngineType engine, unsigned int partSize, unsigned int irSize, bool parallelChannels)
+{
+	switch (engine)
+	{
+	case EngineType::TimeDomain:	return std::unique_ptr<AConvolutionEngine>(new TimeDomainConvolution());
+	case EngineType::FFTNonUniform:	return std::unique_ptr<AConvolutionEngine>(new FFTNonUniformConvolution());
+	case EngineType::FFTBrute:
+	{
+		auto fftConvolution = new FFTConvolution();
+		fftConvolution->setParallelChannels(parallelChannels);
+		return std::unique_ptr<AConvolutionEngine>(fftConvolution);
+	}
+	case EngineType::FFTPartitioned:
+	{
+		auto partConvolution = new FFTPartConvolution();
+		partConvolution->setParallelChannels(parallelChannels);
+		partConvolution->setPartitioningOrder(getPartitioningOrder(partSize, irSize));
+		return std::unique_ptr<AConvolutionEngine>(partConvolution);
+	}
+	}
+	return nullptr;
+}
+
+double EngineCostModel::measure(EngineType engine, unsigned int partSize, unsigned int irSize, unsigned int blockSize, bool parallelChannels)
+{
+	using Clock = std::chrono::steady_clock;
+
+	// decaying noise, the content doesn't matter but denormals would
+	std::mt19937 rng(irSize);
+	std::uniform_real_distribution<float> distribution(-1.f, 1.f);
+
+	std::vector<float> left(irSize), right(irSize);
+	for (unsigned int i = 0; i < irSize; i++)
+	{
+		float gain = std::exp(-4.f * i / irSize);
+		left[i]	 = gain * distribution(rng);
+		right[i] = gain * distribution(rng);
+	}
+
+	auto convolution = createEngine(engine, partSize, irSize, parallelChannels);
+	convolution->setHostBlockSize(blockSize);
+	convolution->setImpulseResponse(ImpulseResponse(left, right, 48000.f));
+
+	std::vector<float> inputL(blockSize), inputR(blockSize), outputL(blockSize), outputR(blockSize);
+	for (unsigned int i = 0; i < blockSize; i++)
+	{
+		inputL[i] = distribution(rng);
+		inputR[i] = distribution(rng);
+	}
+
+	// a full period of the engine, otherwise the FFTs of the brute force engine or large partitions are missed
+	unsigned int period		= std::max({ blockSize, partSize, engine == EngineType::FFTBrute ? IRTools::nextPow2(irSize) : 0U });
+	unsigned int minSamples = 2 * period;
+	unsigned int maxSamples = 32 * minSamples;
+
+	// warm up, also swaps in the kernel
+	for (unsigned int n = 0; n < period; n += blockSize)
+	{
+		convolution->process(inputL.data(), inputR.data(), outputL.data(), outputR.data(), blockSize);
+	}
+
+	unsigned int numSamples = 0;
+	auto start = Clock::now();
+	double elapsed = 0;
+
+	while (numSamples < minSamples || (elapsed < MinMeasurementTime && numSamples < maxSamples))
+	{
+		convolution->process(inputL.data(), inputR.data(), outputL.data(), outputR.data(), blockSize);
+		numSamples += blockSize;
+
+		elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+	}
+
+	return elapsed / numSamples;
+}
+
+unsigned int EngineCostModel::getPartitioningOrder(unsigned int partSize, unsigned int irSize)
+{
+	unsigned int size = IRTools::nextPow2(irSize);
+	return (size > partSize) ? IRTools::staticLog2(size / partSize) : 0;
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include "AConvolutionEngine.h"
+#include <vector>
+#include <memory>
+#include <string>
+#include <atomic>
+
+
+/**
+	Picks the exact convolution engine and partitioning with the lowest CPU cost for an impulse response, a host block size
+	and a latency budget.
+
+	The costs are measured on the machine itself: #calibrate runs short micro benchmarks of every engine over a grid of impulse
+	response sizes, host block sizes and partition sizes and stores the audio thread time per sample. Costs in between the grid
+	points are interpolated log-log, costs outside are extrapolated from the closest two grid points. The measurements can be
+	stored with #save and restored with #load, so the benchmarks only have to run once per machine.
+
+	The FFT engines are measured with or without parallel channels, the way they will run afterwards, see
+	#UniformPartitionedConvolution::setParallelChannels.
+
+	ParFilt is not considered, it only approximates the impulse response.
+*/
+class EngineCostModel
+{
+public:
+	enum class EngineType
+	{
+		TimeDomain,
+		FFTBrute,
+		FFTPartitioned,
+		FFTNonUniform
+	};
+
+	/**
+		An engine configuration together with its latency and estimated cost.
+	*/
+	struct Choice
+	{
+		EngineType engine{ EngineType::FFTNonUniform };
+
+		// partition size and the matching partitioning order of #FFTPartConvolution, FFTPartitioned only
+		unsigned int partSize{ 0 };
+		unsigned int partitioningOrder{ 0 };
+
+		unsigned int latency{ 0 };
+
+		// estimated audio thread time per sample in seconds
+		double cost{ 0 };
+	};
+
+	/**
+		Runs the micro benchmarks and replaces all measurements. Allocates and takes a few seconds, should run on a background thread.
+		@param parallelChannels true to measure the FFT engines with parallel channels
+		@param shouldCancel optional flag that stops the benchmarks early, the model is left without measurements
+	*/
+	void calibrate(bool parallelChannels, const std::atomic<bool> * shouldCancel = nullptr);
+
+	/**
+		Reads measurements written by #save. Fails if the file was written by another version, for another instruction set
+		or with another parallel channels setting.
+		@param path the calibration file
+		@param parallelChannels the parallel channels setting the measurements have to be taken with
+		@return true if the measurements were loaded
+	*/
+	bool load(const std::string & path, bool parallelChannels);
+
+	/**
+		Writes the measurements to a calibration file.
+		@param path the calibration file
+		@return true if the file was written
+	*/
+	bool save(const std::string & path) const;
+
+	/**
+		Returns true if measurements are available.
+	*/
+	bool isCalibrated() const;
+
+	/**
+		Returns true if the FFT engines were measured with parallel channels.
+	*/
+	bool hasParallelChannels() const;
+
+	/**
+		Returns the estimated audio thread time per sample in seconds.
+		@param engine the engine type
+		@param partSize the partition size, FFTPartitioned only
+		@param irSize the impulse response size
+		@param blockSize the host block size
+	*/
+	double estimateCost(EngineType engine, unsigned int partSize, unsigned int irSize, unsigned int blockSize) const;
+
+	/**
+		Returns the engine configuration with the lowest estimated cost within the latency budget. Zero latency engines always fit.
+		@param irSize the impulse response size
+		@param blockSize the host block size
+		@param maxLatency the latency budget in samples
+	*/
+	Choice select(unsigned int irSize, unsigned int blockSize, unsigned int maxLatency) const;
+
+	/**
+		Returns the latency of an engine configuration in samples.
+	*/
+	static unsigned int getLatency(EngineType engine, unsigned int partSize, unsigned int irSize);
+
+	/**
+		Creates and configures an engine, the impulse response still has to be set. Allocates.
+		@param engine the engine type
+		@param partSize the partition size, FFTPartitioned only
+		@param irSize the impulse response size the partitioning is derived for
+		@param parallelChannels true to process the channels of the FFT engines in parallel
+	*/
+	static std::unique_ptr<AConvolutionEngine> createEngine(EngineType engine, unsigned int partSize, unsigned int irSize, bool parallelChannels);
+
+private:
+
+	struct Measurement
+	{
+		EngineType engine;
+		unsigned int partSize;
+		unsigned int irSize;
+		unsigned int blockSize;
+
+		// audio thread time per sample in seconds
+		double cost;
+	};
+
+	/**
+		Measures the audio thread time per sample of a configuration.
+	*/
+	static double measure(EngineType engine, unsigned int partSize, unsigned int irSize, unsigned int blockSize, bool parallelChannels);
+
+	/**
+		Returns the partitioning order of #FFTPartConvolution that results in @p partSize.
+	*/
+	static unsigned int getPartitioningOrder(unsigned int partSize, unsigned int irSize);
+
+private:
+	std::vector<Measurement> measurements;
+
+	// the setting the FFT engines were measured with
+	bool parallelChannels{ false };
+};
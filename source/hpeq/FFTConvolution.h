@@ -1,220 +1,77 @@
 #pragma once
 
-#include "ASyncedConvolutionEngine.h"
+#include "UniformPartitionedConvolution.h"
 #include "AFourierTransformFactory.h"
-#include "StaticQueue.h"
+#include "PartitionedKernel.h"
 #include "IRTools.h"
-#include <array>
 #include <algorithm>
-#include <memory>
-#include <map>
 
 
 /**
-	FFConvolution implements a latency heavy, brute force convolution engine using FFTs. 
-		
+	FFConvolution implements a latency heavy, brute force convolution engine using FFTs.
+
 	For a impuls response of size N = 2^n:
-	- buffers up to N input samples, simultaniously outputs samples from the output queue
-	- zero pads the input to 2*N, perform FFT, per sample complex multiplication, IFFT
-	- store the first half (0..N-1) in primary queue, adding old samples from the secondary queue
-	- we store the second half (N..2*N-1) in secondary queue for next FFT
+	- buffers up to N input samples block wise, simultaniously outputs the last output block from the overlap add accumulator
+	- zero pads the input to 2*N, perform real valued FFT, per bin complex multiplication for the N+1 non-negative frequency bins, IFFT
+	- the first half (0..N-1) plus the tail of the last convolution becomes the next output block
+	- we store the second half (N..2*N-1) as tail for the next FFT
 
 	That means: The latency is determined by the impulse response length.
 
-	@param MaxSize maximum supported impulse response time, needs to be power of 2
+	The kernel FFT, the FFT engine and all buffers are created by the pre processor and sized to the impulse response, see #UniformPartitionedKernel.
+	With #setLoadBalancing, the work of a block is spread over the host callbacks of the next block. The single partition makes
+	the four transforms the bulk of a block and each of them still runs in one callback, so the peak per callback only drops to
+	about a quarter of the unbalanced peak, not to the average.
+	With #setParallelChannels, the channels are processed in parallel on the audio thread and a worker thread.
+	The block scheduling is shared with #FFTPartConvolution, see #UniformPartitionedConvolution.
 */
-template<unsigned int MaxSize>
-class FFTConvolution : public ASyncedConvolutionEngine<ImpulseResponse>
+class FFTConvolution : public UniformPartitionedConvolution<UniformPartitionedKernel>
 {
 private:
-    static const unsigned int MaxOrder = 1 + IRTools::staticLog2(MaxSize);
 	unsigned int MinOrder = 5;
 
 public:
 	FFTConvolution();
 
-	// Inherited via AConvolutionEngine
-	virtual void process(const float * readL, const float * readR, float * writeL, float * writeR, unsigned int numSamples) override;
-
 protected:
 
-	
 	// Inherited via ASyncedConvolutionEngine
-	virtual void onDataUpdate() override;
-	virtual ImpulseResponse preProcess(const ImpulseResponse &ir) override;
-
-private:
-
-	void updateKernelFFT();
-
-	/**
-		Runs the FFT convolution and puts samples were they belong
-	*/
-	void performConvolution(); 
-
-private:
-
-
+	virtual UniformPartitionedKernel preProcess(const ImpulseResponse &ir) override;
 
-	std::array<std::complex<float>, 2 * MaxSize> audioFFTs[2];
-
-	unsigned int numQueuedSamples{ 0 };
-
-	// used to write directly to output
-	StaticQueue<float, MaxSize> outputQueue[2];
-
-	// used to cache output latency tail and add to
-	StaticQueue<float, MaxSize> secondaryOutputQueue[2];
-
-
-
-	std::array<std::complex<float>, MaxSize> kernelFFTs[2];
-
-	std::map<unsigned int, std::unique_ptr<AFourierTransform>> fftEngines; // contains fft fftEngines assigned to their orders
-
-	unsigned int currentFFTOrder{ MinOrder }; 
-	unsigned int currentFFTSize{ 0 };
+	// Inherited via UniformPartitionedConvolution
+	virtual unsigned int getPartitionSize(unsigned int irSize) const override;
 };
 
-template<unsigned int MaxSize>
-inline FFTConvolution<MaxSize>::FFTConvolution()
+inline FFTConvolution::FFTConvolution()
 {
-	assert(isPowerOfTwo(MaxSize));
-
-
-	for (int order = MinOrder; order <= MaxOrder; order++)
-	{
-		fftEngines[order] = std::unique_ptr<AFourierTransform>(AFourierTransformFactory::FourierTransform(order));
-	}
-
 	onImpulseResponseUpdate();
 }
 
-template<unsigned int MaxSize>
-inline void FFTConvolution<MaxSize>::process(const float * readL, const float * readR, float * writeL, float * writeR, unsigned int numSamples)
+inline UniformPartitionedKernel FFTConvolution::preProcess(const ImpulseResponse & ir)
 {
-	updateData();
-
-	for (int i = 0; i < numSamples; i++)
-	{
-		// cache input in audio working buffer
-		audioFFTs[0][this->numQueuedSamples]  = readL[i];
-		audioFFTs[1][this->numQueuedSamples] = readR[i];
-		numQueuedSamples++;
-
-		// perform fft if we have enough samples
-		if (numQueuedSamples == currentFFTSize)
-		{
-			performConvolution();
-		}
-
-		// write from queue to output
-		writeL[i] = outputQueue[0].pull();
-		writeR[i] = outputQueue[1].pull();
-	}
-}
+	// a single partition covering the full impulse response
+	auto kernel = UniformPartitionedKernel::create(ir, getPartitionSize(ir.getSize()), 0, loadBalancing);
+
+	prepareChannelWorker(kernel, ir);
 
+	return kernel;
+}
 
-template<unsigned int MaxSize>
-inline void FFTConvolution<MaxSize>::onDataUpdate()
+inline unsigned int FFTConvolution::getPartitionSize(unsigned int irSize) const
 {
-	unsigned int size = getData()->getSize();
+	unsigned int size = irSize;
 	size = IRTools::nextPow2(size);
 
-	assert(size <= MaxSize);
-
 	unsigned int requiredOrder = IRTools::staticLog2(size) + 1;
 
 	unsigned int usedOrder = std::max(requiredOrder, MinOrder);
-	assert(requiredOrder <= MaxOrder);
-
-	currentFFTOrder = usedOrder;
-
-	currentFFTSize =  std::pow(2, currentFFTOrder - 1);
 
 	/*
 		Some background:
 		We have a IR of size N=2^n, lets say 16. We want to use the next possible FFT order, so 32. A convolution
-		will spit out (N+M-1) samples, so we can collect 17 samples (2^n+1) befor we need to run the FFT. For simplicity, we can 
+		will spit out (N+M-1) samples, so we can collect 17 samples (2^n+1) befor we need to run the FFT. For simplicity, we can
 		ignore that last sample and just work with 2^n.
 	*/
 
-	numQueuedSamples = 0;
-	outputQueue[0].clear();
-	outputQueue[1].clear();
-	secondaryOutputQueue[0].clear();
-	secondaryOutputQueue[1].clear();
-
-	// add queue to have enough output for 2^n samples
-	outputQueue[0].push(0, currentFFTSize);
-	outputQueue[1].push(0, currentFFTSize);
-	secondaryOutputQueue[0].push(0, currentFFTSize);
-	secondaryOutputQueue[1].push(0, currentFFTSize);
-
-	updateKernelFFT();
-}
-
-template<unsigned int MaxSize>
-inline ImpulseResponse FFTConvolution<MaxSize>::preProcess(const ImpulseResponse & ir)
-{
-	return ir;
-}
-
-template<unsigned int MaxSize>
-inline void FFTConvolution<MaxSize>::updateKernelFFT()
-{
-	std::fill(kernelFFTs[0].begin(), kernelFFTs[0].end(), 0);
-	std::fill(kernelFFTs[1].begin(), kernelFFTs[1].end(), 0);
-
-	auto ir = getData();
-
-	for (int i = 0; i < ir->getSize(); i++)
-	{
-		kernelFFTs[0][i] = ir->getLeft()[i];
-		kernelFFTs[1][i] = ir->getRight()[i];
-	}
-
-	fftEngines[currentFFTOrder]->performFFTInPlace(kernelFFTs[0].data());
-	fftEngines[currentFFTOrder]->performFFTInPlace(kernelFFTs[1].data());
-}
-
-template<unsigned int MaxSize>
-inline void FFTConvolution<MaxSize>::performConvolution()
-{
-	// zero pad input
-	for (int i = currentFFTSize; i < (2 * currentFFTSize); i++)
-	{
-		audioFFTs[0][i] = audioFFTs[1][i] = 0;
-	}
-
-	// to frequency domain
-	fftEngines[currentFFTOrder]->performFFTInPlace(audioFFTs[0].data());
-	fftEngines[currentFFTOrder]->performFFTInPlace(audioFFTs[1].data());
-
-	// per sample multiplication
-	for (int i = 0; i < (2 * currentFFTSize); i++)
-	{
-		audioFFTs[0][i]  *= kernelFFTs[0][i];
-		audioFFTs[1][i] *= kernelFFTs[1][i];
-	}
-
-	// back to time domain
-	fftEngines[currentFFTOrder]->performIFFTInPlace(audioFFTs[0].data());
-	fftEngines[currentFFTOrder]->performIFFTInPlace(audioFFTs[1].data());
-
-
-	// cache the first half of the samples directly to the output
-	// cache the second half to the queue for later use
-	for (int i = 0; i < currentFFTSize; i++)
-	{
-		// write first half and secondary queue to output queue
-		outputQueue[0].push(audioFFTs[0][i].real() + secondaryOutputQueue[0].pull());
-		outputQueue[1].push(audioFFTs[1][i].real() + secondaryOutputQueue[1].pull());
-
-		// write second half to secondary queue for later use
-		secondaryOutputQueue[0].push(audioFFTs[0][i + currentFFTSize].real());
-		secondaryOutputQueue[1].push(audioFFTs[1][i + currentFFTSize].real());
-	}
-
-	numQueuedSamples = 0;
+	return 1 << (usedOrder - 1);
 }
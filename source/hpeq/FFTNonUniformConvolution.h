@@ -0,0 +1,261 @@
+#pragma once
+
+#include "ASyncedConvolutionEngine.h"
+#include "AFourierTransformFactory.h"
+#include "PartitionedKernel.h"
+#include "IRTools.h"
+#include <vector>
+#include <algorithm>
+
+
+/**
+	Contains the partitioned and fourier transformed impulse response used by #FFTNonUniformConvolution together with
+	the processing state that depends on the partitioning. Created by the pre processor and swapped into the audio thread as a whole.
+*/
+struct NonUniformKernel
+{
+	/**
+		A group of uniformly sized partitions. Every level implements the frequency delay line approach of #FFTPartConvolution
+		with its own partition size.
+	*/
+	struct Level : public PartitionedKernel
+	{
+		// position of the first partition in the impulse response
+		unsigned int offset{ 0 };
+	};
+
+	// the first samples of the impulse response, convolved in time domain
+	std::vector<float> head[2];
+
+	std::vector<Level> levels;
+
+	// input history, ring buffer with a power of 2 size
+	std::vector<float> history[2];
+	unsigned int historyMask{ 0 };
+
+	// overlap add output accumulator, ring buffer with a power of 2 size
+	std::vector<float> accumulator[2];
+	unsigned int accumulatorMask{ 0 };
+
+	// fft working buffers, sized for the biggest partition
+	std::vector<float> fftBuffer;
+	std::vector<std::complex<float>> spectrumBuffer;
+
+	// number of samples processed since the kernel became active
+	unsigned int numProcessedSamples{ 0 };
+};
+
+/**
+	FFTNonUniformConvolution implements a zero latency convolution engine with non-uniform partitioning as discussed in Gardner 1995.
+
+	The impulse response is split into:
+	- a short head that is convolved in time domain, providing the first output samples without latency
+	- a number of levels with geometrically growing partition sizes (two partitions per size, the last level takes the remaining tail)
+
+	A partition of size N can be computed with an FFT of size 2N once N input samples were collected. As long as the partition
+	starts at a position >= N in the impulse response, its output is available in time. Each level implements the frequency
+	delay line approach of #FFTPartConvolution with real valued FFTs. The CPU load is close to the uniformly partitioned engine while the latency is zero.
+	All buffers are created by the pre processor and sized to the impulse response.
+*/
+class FFTNonUniformConvolution : public ASyncedConvolutionEngine<NonUniformKernel>
+{
+private:
+	// size of the time domain head and of the smallest partition
+	static const unsigned int HeadOrder = 6;
+	static const unsigned int HeadSize  = 1 << HeadOrder;
+
+	// limits the biggest partition and thus the cost of a single fft
+	static const unsigned int MaxPartOrder = 13;
+
+public:
+	FFTNonUniformConvolution();
+
+	// Inherited via AConvolutionEngine
+	virtual void process(const float * readL, const float * readR, float * writeL, float * writeR, unsigned int numSamples) override;
+
+protected:
+
+	// Inherited via ASyncedConvolutionEngine
+	virtual NonUniformKernel preProcess(const ImpulseResponse & ir) override;
+
+private:
+
+	/**
+		Runs the FFT convolution of a level for the last partSize input samples and adds the result to the accumulator.
+	*/
+	void performConvolution(NonUniformKernel & kernel, NonUniformKernel::Level & level);
+};
+
+inline FFTNonUniformConvolution::FFTNonUniformConvolution()
+{
+	onImpulseResponseUpdate();
+}
+
+inline void FFTNonUniformConvolution::process(const float * readL, const float * readR, float * writeL, float * writeR, unsigned int numSamples)
+{
+	updateData();
+
+	auto kernel = getData();
+
+	if (kernel->history[0].empty())
+	{
+		std::fill(writeL, writeL + numSamples, 0.f);
+		std::fill(writeR, writeR + numSamples, 0.f);
+		return;
+	}
+
+	const float * read[2]  = { readL, readR };
+	float		* write[2] = { writeL, writeR };
+
+	unsigned int headSize = kernel->head[0].size();
+
+	unsigned int i = 0;
+	while (i < numSamples)
+	{
+		// process up to the next partition boundary of the smallest level
+		unsigned int samplesToBoundary = HeadSize - (kernel->numProcessedSamples & (HeadSize - 1));
+		unsigned int numRunSamples = std::min(numSamples - i, samplesToBoundary);
+
+		for (int c : {0, 1})
+		{
+			auto & history	   = kernel->history[c];
+			auto & accumulator = kernel->accumulator[c];
+			auto head		   = kernel->head[c].data();
+
+			for (unsigned int k = 0; k < numRunSamples; k++)
+			{
+				unsigned int t = kernel->numProcessedSamples + k;
+				history[t & kernel->historyMask] = read[c][i + k];
+
+				// time domain head
+				float out = 0;
+				for (unsigned int j = 0; j < headSize; j++)
+				{
+					out += head[j] * history[(t - j) & kernel->historyMask];
+				}
+
+				// partitions computed earlier
+				auto & acc = accumulator[t & kernel->accumulatorMask];
+				write[c][i + k] = out + acc;
+				acc = 0;
+			}
+		}
+
+		kernel->numProcessedSamples += numRunSamples;
+		i += numRunSamples;
+
+		// every level fires when it collected a full partition of input samples
+		for (auto & level : kernel->levels)
+		{
+			if ((kernel->numProcessedSamples & (level.partSize - 1)) == 0)
+			{
+				performConvolution(*kernel, level);
+			}
+		}
+	}
+}
+
+inline NonUniformKernel FFTNonUniformConvolution::preProcess(const ImpulseResponse & ir)
+{
+	NonUniformKernel kernel;
+
+	unsigned int irSize = ir.getSize();
+
+	unsigned int headSize = std::min(irSize, static_cast<unsigned int>(HeadSize));
+
+	for (int c : {0, 1})
+	{
+		kernel.head[c] = std::vector<float>(ir.getChannel(c), ir.getChannel(c) + headSize);
+	}
+
+	// create partitioning, two partitions per size, last level takes the remaining tail
+	unsigned int offset   = headSize;
+	unsigned int partSize = HeadSize;
+
+	while (offset < irSize)
+	{
+		unsigned int remaining = irSize - offset;
+		bool isLast = (partSize >= (1U << MaxPartOrder)) || (remaining <= 2 * partSize);
+
+		NonUniformKernel::Level level;
+		static_cast<PartitionedKernel&>(level) = PartitionedKernel::create(ir, partSize, offset, isLast ? 0 : 2);
+		level.offset = offset;
+
+		offset   += level.numPartitions * partSize;
+		kernel.levels.push_back(std::move(level));
+		partSize *= 2;
+	}
+
+	unsigned int maxPartSize = HeadSize;
+	unsigned int maxDelay	 = HeadSize;
+
+	for (auto & level : kernel.levels)
+	{
+		maxPartSize = std::max(maxPartSize, level.partSize);
+		maxDelay	= std::max(maxDelay, level.offset + 2 * level.partSize);
+	}
+
+	unsigned int historySize	 = IRTools::nextPow2(maxPartSize);
+	unsigned int accumulatorSize = IRTools::nextPow2(maxDelay);
+
+	kernel.historyMask	   = historySize - 1;
+	kernel.accumulatorMask = accumulatorSize - 1;
+
+	for (int c : {0, 1})
+	{
+		kernel.history[c].resize(historySize, 0);
+		kernel.accumulator[c].resize(accumulatorSize, 0);
+	}
+
+	kernel.fftBuffer.resize(2 * maxPartSize, 0);
+	kernel.spectrumBuffer.resize(maxPartSize + 1, 0);
+
+	return kernel;
+}
+
+inline void FFTNonUniformConvolution::performConvolution(NonUniformKernel & kernel, NonUniformKernel::Level & level)
+{
+	/*
+		The level collected the input samples [t - N, t), with N = partSize and t = numProcessedSamples.
+		The convolution of that block with the frequency delay line contributes to the output samples
+		starting at t - N + offset. With offset >= N, none of them has been written to the output yet.
+	*/
+
+	auto & fft		= level.fft;
+	auto fftSize	= 2 * level.partSize;
+	auto buffer		= kernel.fftBuffer.data();
+	auto spectrum	= kernel.spectrumBuffer.data();
+	unsigned int t	= kernel.numProcessedSamples;
+
+	for (int c : {0, 1})
+	{
+		auto & history = kernel.history[c];
+
+		// zero padded input
+		for (unsigned int i = 0; i < level.partSize; i++)
+		{
+			buffer[i] = history[(t - level.partSize + i) & kernel.historyMask];
+		}
+		std::fill(buffer + level.partSize, buffer + fftSize, 0.f);
+
+		// to frequency domain
+		fft->performRealFFT(buffer, spectrum);
+		level.setInputFFT(c, spectrum);
+
+		// per parition complex multiplication
+		level.accumulateSpectrum(c, spectrum);
+
+		// back to time domain
+		fft->performRealIFFT(spectrum, buffer);
+
+		// overlap add
+		auto & accumulator = kernel.accumulator[c];
+		unsigned int outputStart = t - level.partSize + level.offset;
+		for (unsigned int i = 0; i < fftSize; i++)
+		{
+			accumulator[(outputStart + i) & kernel.accumulatorMask] += buffer[i];
+		}
+	}
+
+	level.advance();
+}
@@ -1,144 +1,140 @@
 #pragma once
 
-#include "ASyncedConvolutionEngine.h"
+#include "UniformPartitionedConvolution.h"
 #include "AFourierTransformFactory.h"
-#include "StaticQueue.h"
+#include "PartitionedKernel.h"
+#include "LatePartitionWorker.h"
 #include "IRTools.h"
-#include <array>
 #include <algorithm>
 #include <memory>
-#include <map>
+#include <atomic>
 
 
 /**
-	FFTPartConvolution implements a simple partitioned FFT where the full impulse response is split in P partitions. 
+	The #UniformPartitionedKernel used by #FFTPartConvolution. With background processing, the kernel only contains the first
+	partitions and the late partitions are computed by the #LatePartitionWorker.
+*/
+struct PartConvolutionKernel : public UniformPartitionedKernel
+{
+	// computes the late partitions, nullptr if all partitions are processed on the audio thread
+	std::unique_ptr<LatePartitionWorker> lateWorker;
+};
+
+
+/**
+	FFTPartConvolution implements a simple partitioned FFT where the full impulse response is split in P partitions.
 	The number of partitions is set by #setPartitioningOrder where the order n sets the number of partitions P = 2^N;
+	With #setBlockAlignedPartitioning, the partition size follows the host block size instead, see #setHostBlockSize.
 
 	The engine implements the frequency delay line approach discussed in Eric Battenberg, Rimas Avizienis 2011 to prevent unnecessary FFT calls.
-	
-	@param MaxSize maximum supported impulse response time, needs to be power of 2
+	Partitions are transformed with real valued FFTs, so only the N+1 non-negative frequency bins of a 2N FFT are stored and multiplied.
+	The partition FFTs, the FFT engine and all buffers are created by the pre processor and sized to the impulse response, see #UniformPartitionedKernel.
+
+	For long impulse responses, the multiply accumulate of the late partitions can be moved to a worker thread, see #setBackgroundProcessing.
+	The audio thread then only computes the FFTs and the first partitions, so the cost per callback no longer grows with the impulse response.
+	The audio thread never waits for the worker, a block whose late part isn't ready goes out without it, see #getNumMissedDeadlines.
+	With #setLoadBalancing, the work of a block is spread evenly over the host callbacks of a partition period.
+	With #setParallelChannels, the channels are processed in parallel on the audio thread and a worker thread.
+	The block scheduling is shared with #FFTConvolution, see #UniformPartitionedConvolution.
 */
-template<unsigned int MaxSize>
-class FFTPartConvolution : public  ASyncedConvolutionEngine<ImpulseResponse>
+class FFTPartConvolution : public UniformPartitionedConvolution<PartConvolutionKernel>
 {
 private:
 	unsigned int MinOrder = 5;
-	static const unsigned int MaxOrder = 1 + IRTools::staticLog2(MaxSize);
+
+	// minimum number of partitions for background processing, below the worker isn't worth the thread
+	static const unsigned int MinBackgroundPartitions = 8;
 
 public:
 	FFTPartConvolution();
 
-	// Inherited via AConvolutionEngine
-	virtual void process(const float * readL, const float * readR, float * writeL, float * writeR, unsigned int numSamples) override;
-	
 	/*
 		Sets the number of partitions used to split the impulse response with number P = 2^order
 		@param order the order for the partitioning where the number of partition equals P = 2^order
 	**/
 	void setPartitioningOrder(unsigned int order);
 
-protected:
-
-	// Inherited via ASyncedConvolutionEngine
-	virtual void onDataUpdate() override;
-	virtual ImpulseResponse preProcess(const ImpulseResponse & ir) override;
-
-private:
-
 	/**
-		Updates the fourier transformed IR partitions
+		Aligns the partition size to the host block size instead of deriving it from the partitioning order. With a power of 2
+		host block size, every callback completes exactly one partition: the FFTs run once per callback and the latency is one host block.
+		Otherwise the partition size is the largest power of 2 below the host block size. Has no effect while the host block size is unknown.
+		@param enabled true to align the partitions to the host block size
 	*/
-	void updateKernelFFT();
+	void setBlockAlignedPartitioning(bool enabled);
 
 	/**
-		Runs the FFT convolution and puts samples were they belong
+		Enables computing the late partitions on a worker thread, see #LatePartitionWorker. Only used for impulse responses with
+		at least #MinBackgroundPartitions partitions. Off by default, a worker that can't keep up drops the late partitions of a block.
+		@param enabled true to use the worker thread
 	*/
-	void performConvolution(); 
-
-private:
-
-
-	// caches the input fft buffer befor it's
-	std::array<std::complex<float>, 2 * MaxSize> audioInput[2];
-		
-	// the number of samples currently stored in audioInput
-	unsigned int numQueuedSamples{ 0 };
-
-	// caches one or multiple partition FFTs in this 
-	std::array<std::complex<float>, 2 * MaxSize> partitionFFTCache[2];
-	
+	void setBackgroundProcessing(bool enabled);
 
-	// used to write directly to output
-	StaticQueue<float, MaxSize> outputQueue[2];
+	/**
+		Returns the number of blocks output without their late partitions because the worker missed its deadline. Any thread.
+	*/
+	unsigned int getNumMissedDeadlines() const;
 
-	// used to cache output latency tail and add to
-	StaticQueue<float, MaxSize> secondaryOutputQueue[2];
-	
-	// fft's of our partitioned impulse response
-	std::array<std::complex<float>, 2*MaxSize> kernelFFTs[2];
+protected:
 
-	std::map<unsigned int, std::unique_ptr<AFourierTransform>> fftEngines; // contains fft fftEngines assigned to their orders
+	// Inherited via ASyncedConvolutionEngine
+	virtual void onHostBlockSizeUpdate() override;
+	virtual PartConvolutionKernel preProcess(const ImpulseResponse & ir) override;
 
-	unsigned int currentFFTOrder{ MinOrder }; 
+	// Inherited via UniformPartitionedConvolution
+	virtual unsigned int getPartitionSize(unsigned int irSize) const override;
+	virtual void performConvolution(PartConvolutionKernel & kernel) override;
+	virtual void onInputStage(PartConvolutionKernel & kernel, unsigned int channel) override;
+	virtual void onOutputStage(PartConvolutionKernel & kernel, unsigned int channel) override;
 
-	// size of the partitions and fft
-	unsigned int currentFFTSize{ 0 };
+private:
 
 	// order of paritioning as requested by extern calls
 	unsigned int requestedPartOrder{ 0 };
 
-	// number of partitions currently used
-	unsigned int numPartitions{ 1 };
+	bool blockAligned{ false };
 
-	// index of the current partition;
-	unsigned int currentPartition{ 0 };
+	bool backgroundProcessing{ false };
+
+	std::atomic<unsigned int> numMissedDeadlines{ 0 };
 };
 
-template<unsigned int MaxSize>
-inline FFTPartConvolution<MaxSize>::FFTPartConvolution()
+inline FFTPartConvolution::FFTPartConvolution()
 {
-	assert(isPowerOfTwo(MaxSize));
-	
-	for (int order = MinOrder; order <= MaxOrder; order++)
-	{
-		fftEngines[order] = std::unique_ptr<AFourierTransform>(AFourierTransformFactory::FourierTransform(order));
-	}
-
 	onImpulseResponseUpdate();
 }
 
-template<unsigned int MaxSize>
-inline void FFTPartConvolution<MaxSize>::process(const float * readL, const float * readR, float * writeL, float * writeR, unsigned int numSamples)
+inline PartConvolutionKernel FFTPartConvolution::preProcess(const ImpulseResponse & ir)
 {
-	updateData();
+	unsigned int usedPartSize = getPartitionSize(ir.getSize());
+	unsigned int numPartitions = (ir.getSize() + usedPartSize - 1) / usedPartSize;
 
-	for (int i = 0; i < numSamples; i++)
+	PartConvolutionKernel kernel;
+
+	if (backgroundProcessing && numPartitions >= MinBackgroundPartitions)
 	{
-		// cache input in audio working buffer
-		audioInput[0][this->numQueuedSamples] = readL[i];
-		audioInput[1][this->numQueuedSamples] = readR[i];
-		numQueuedSamples++;
-
-		// perform fft if we have enough samples
-		if (numQueuedSamples == currentFFTSize)
-		{
-			performConvolution();
-		}
-
-		// write from queue to output
-		writeL[i] = outputQueue[0].pull();
-		writeR[i] = outputQueue[1].pull();
+		// the audio thread keeps the first partitions, the worker takes the rest
+		static_cast<UniformPartitionedKernel&>(kernel) = UniformPartitionedKernel::create(ir, usedPartSize, LatePartitionWorker::Delay, loadBalancing);
+		kernel.lateWorker.reset(new LatePartitionWorker(ir, usedPartSize));
+	}
+	else
+	{
+		static_cast<UniformPartitionedKernel&>(kernel) = UniformPartitionedKernel::create(ir, usedPartSize, 0, loadBalancing);
 	}
-}
 
+	prepareChannelWorker(kernel, ir);
 
-template<unsigned int MaxSize>
-inline void FFTPartConvolution<MaxSize>::onDataUpdate()
+	return kernel;
+}
+
+inline unsigned int FFTPartConvolution::getPartitionSize(unsigned int irSize) const
 {
-	unsigned int size = getData()->getSize();
-	size = IRTools::nextPow2(size);
+	// the partitions complete at the end of every host block, the FFTs don't fire mid block
+	if (blockAligned && getHostBlockSize() > 0)
+	{
+		return std::max(1U << IRTools::staticLog2(getHostBlockSize()), 1U << (MinOrder - 1));
+	}
 
-	assert(size <= MaxSize);
+	unsigned int size = IRTools::nextPow2(irSize);
 
 	// now calculating the size of parititons
 	unsigned int partSize = size >> requestedPartOrder;
@@ -146,87 +142,52 @@ inline void FFTPartConvolution<MaxSize>::onDataUpdate()
 	unsigned int requiredFFTOrder = IRTools::staticLog2(partSize) + 1;
 
 	unsigned int usedOrder = std::max(requiredFFTOrder, MinOrder);
-	assert(requiredFFTOrder <= MaxOrder);
-
-	currentFFTOrder = usedOrder;
-
-	currentFFTSize =  std::pow(2, currentFFTOrder - 1);
-
-	numPartitions = std::max(size / currentFFTSize, static_cast<unsigned int>(1));
 
 	/*
 		Some background:
 		We have a IR of size N=2^n, lets say 16. We want to use the next possible FFT order, so 32. A convolution
-		will spit out (N+M-1) samples, so we can collect 17 samples (2^n+1) befor we need to run the FFT. For simplicity, we can 
+		will spit out (N+M-1) samples, so we can collect 17 samples (2^n+1) befor we need to run the FFT. For simplicity, we can
 		ignore that last sample and just work with 2^n.
 	*/
 
-	// clear buffers, prepare queues
-	for (auto c : { 0,1 })
-	{
-		audioInput[c].fill(0);
-		partitionFFTCache[c].fill(0);
-		outputQueue[c].clear();
-		outputQueue[c].push(0, currentFFTSize);
-
-		secondaryOutputQueue[c].clear();
-		secondaryOutputQueue[c].push(0, currentFFTSize);
-	}
+	return 1 << (usedOrder - 1);
+}
 
-	numQueuedSamples = 0;
-	currentPartition = 0;
+inline void FFTPartConvolution::onHostBlockSizeUpdate()
+{
+	if (blockAligned) onImpulseResponseUpdate();
+}
 
+inline void FFTPartConvolution::setBlockAlignedPartitioning(bool enabled)
+{
+	if (enabled == blockAligned) return;
 
-	updateKernelFFT();
+	this->blockAligned = enabled;
+	onImpulseResponseUpdate();
 }
 
-template<unsigned int MaxSize>
-inline ImpulseResponse FFTPartConvolution<MaxSize>::preProcess(const ImpulseResponse & ir)
+inline void FFTPartConvolution::setBackgroundProcessing(bool enabled)
 {
-	return ir;
+	if (enabled == backgroundProcessing) return;
+
+	this->backgroundProcessing = enabled;
+	onImpulseResponseUpdate();
 }
 
-template<unsigned int MaxSize>
-inline void FFTPartConvolution<MaxSize>::setPartitioningOrder(unsigned int order)
+inline unsigned int FFTPartConvolution::getNumMissedDeadlines() const
 {
-	this->requestedPartOrder = order;
-	onImpulseResponseUpdate();
+	return numMissedDeadlines.load();
 }
 
-template<unsigned int MaxSize>
-inline void FFTPartConvolution<MaxSize>::updateKernelFFT()
+inline void FFTPartConvolution::setPartitioningOrder(unsigned int order)
 {
-	/**
-		Some notes: the partitions are split up evenly, with partition size P, the first partition in
-		kernelFFTs is at index 0, second at P, third at 2*P and so on.
-	*/
+	if (order == requestedPartOrder) return;
 
-	// set order, just to be sure
-	currentFFTOrder = IRTools::staticLog2(currentFFTSize) + 1;
-	for (int c : {0, 1})
-	{
-		kernelFFTs[c].fill(0);
-
-		auto buffer = getData()->getChannel(c);
-
-		for (int p = 0; p < numPartitions; p++)
-		{
-			unsigned int irBufferOffset  = p * currentFFTSize;
-			unsigned int fftBufferOffset = 2 * irBufferOffset;
-
-			unsigned int irMaxPos = std::min(getData()->getSize() - irBufferOffset, currentFFTSize);
-			for (int i = 0; i < irMaxPos; i++)
-			{
-				kernelFFTs[c][i + fftBufferOffset] = buffer[i + irBufferOffset];
-			}
-			
-			fftEngines[currentFFTOrder]->performFFTInPlace(&kernelFFTs[c][fftBufferOffset]);
-		}
-	}
+	this->requestedPartOrder = order;
+	onImpulseResponseUpdate();
 }
 
-template<unsigned int MaxSize>
-inline void FFTPartConvolution<MaxSize>::performConvolution()
+inline void FFTPartConvolution::performConvolution(PartConvolutionKernel & kernel)
 {
 	/*
 		For every performConvolution call, we need to:
@@ -235,63 +196,59 @@ inline void FFTPartConvolution<MaxSize>::performConvolution()
 			- complex multiplication
 		- sum up all partiotions
 		- ifft
-		- feed queues
-
-		Note on the partitionFFTCache: We handle it as a ring buffer, 
+		- overlap add
 
+		Note on the partitionFFTCache: We handle it as a ring buffer, see #PartitionedKernel
+		With a late worker, the new input is handed to the worker and its result for this block is added befor the ifft.
+		With a channel worker, the channels run in parallel, see #UniformPartitionedKernel::forEachChannel.
 	*/
-	
 
-	// zero pad input
-	for (int i = currentFFTSize; i < (2 * currentFFTSize); i++)
+	auto lateWorker = kernel.lateWorker.get();
+
+	if (!lateWorker)
 	{
-		audioInput[0][i] = audioInput[1][i] = 0;
+		UniformPartitionedConvolution::performConvolution(kernel);
+		return;
 	}
 
-	auto currentPartitionChaceOffset = currentPartition * (2 * currentFFTSize);
+	// the late worker takes the spectra of both channels at once, the channels are joined around it
+	auto processInput = [&kernel, lateWorker](unsigned int c)
+	{
+		kernel.transformInput(c);
+		lateWorker->setInput(c, kernel.outputFFT[c].data());
 
-	// to frequency domain
-	fftEngines[currentFFTOrder]->performFFT(audioInput[0].data(), &partitionFFTCache[0][currentPartitionChaceOffset]);
-	fftEngines[currentFFTOrder]->performFFT(audioInput[1].data(), &partitionFFTCache[1][currentPartitionChaceOffset]);
+		// per parition complex multiplication
+		kernel.accumulateSpectrum(c, kernel.outputFFT[c].data());
+	};
 
-	// first partition out of loop so that we don't need to flush the buffer first
-	for (int i = 0; i < (2*currentFFTSize); i++)
+	auto processOutput = [&kernel](unsigned int c)
 	{
-		audioInput[0][i] = partitionFFTCache[0][currentPartitionChaceOffset + i] * kernelFFTs[0][i];
-		audioInput[1][i] = partitionFFTCache[1][currentPartitionChaceOffset + i] * kernelFFTs[1][i];
-	}
+		kernel.transformOutput(c);
+	};
 
-	// per parition
-	for (int p = 1; p < numPartitions; p++)
-	{
-		auto kernelOffset = 2 * currentFFTSize * p;
-		auto cacheOffset  = 2 * currentFFTSize * ((currentPartition + numPartitions - p) % numPartitions);
-		for (int i = 0; i < (2 * currentFFTSize); i++)
-		{
-			audioInput[0][i] += partitionFFTCache[0][cacheOffset + i] * kernelFFTs[0][kernelOffset + i];
-			audioInput[1][i] += partitionFFTCache[1][cacheOffset + i] * kernelFFTs[1][kernelOffset + i];
-		}
-	}
+	kernel.forEachChannel(processInput);
 
-	// back to time domain
-	fftEngines[currentFFTOrder]->performIFFTInPlace(audioInput[0].data());
-	fftEngines[currentFFTOrder]->performIFFTInPlace(audioInput[1].data());
+	lateWorker->submit();
+	if (!lateWorker->addResult(kernel.outputFFT[0].data(), kernel.outputFFT[1].data())) numMissedDeadlines++;
 
+	kernel.forEachChannel(processOutput);
+}
 
-	// cache the first half of the samples directly to the output
-	// cache the second half to the queue for later use
-	for (int i = 0; i < currentFFTSize; i++)
-	{
-		// write first half and secondary queue to output queue
-		outputQueue[0].push(audioInput[0][i].real() + secondaryOutputQueue[0].pull());
-		outputQueue[1].push(audioInput[1][i].real() + secondaryOutputQueue[1].pull());
+inline void FFTPartConvolution::onInputStage(PartConvolutionKernel & kernel, unsigned int channel)
+{
+	auto lateWorker = kernel.lateWorker.get();
+	if (!lateWorker) return;
 
-		// write second half to secondary queue for later use
-		secondaryOutputQueue[0].push(audioInput[0][i + currentFFTSize].real());
-		secondaryOutputQueue[1].push(audioInput[1][i + currentFFTSize].real());
-	}
+	// the balanced scheduling runs on the audio thread only, the right channel is always transformed last
+	lateWorker->setInput(channel, kernel.outputFFT[channel].data());
+	if (channel == 1) lateWorker->submit();
+}
+
+inline void FFTPartConvolution::onOutputStage(PartConvolutionKernel & kernel, unsigned int channel)
+{
+	auto lateWorker = kernel.lateWorker.get();
+	if (!lateWorker || channel != 0) return;
 
-	// increment artition
-	currentPartition = (currentPartition + 1) % numPartitions;
-	numQueuedSamples = 0;
+	// the result of both channels is added befor the first ifft
+	if (!lateWorker->addResult(kernel.outputFFT[0].data(), kernel.outputFFT[1].data())) numMissedDeadlines++;
 }
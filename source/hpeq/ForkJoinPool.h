@@ -0,0 +1,334 @@
+#pragma once
+
+#include "Semaphore.h"
+#include "RealtimeThread.h"
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <cstdint>
+#include <cassert>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+#endif
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+
+/**
+	A small pool of real time worker threads that run the jobs of a fork join section together with the calling thread,
+	e.g. to process the channels of an audio block in parallel inside the audio callback.
+
+	#run publishes the jobs and takes part in their processing, so the audio thread processes one channel while a worker processes
+	the other, and returns once all jobs are done. A worker claims a job right before it runs it, every job no worker claimed in time
+	is taken over by the calling thread. So #run only waits for jobs that are already running, on workers with real time priority,
+	see #RealtimeThread::setPriority.
+
+	Neither #run nor the workers lock or allocate. After a section, the workers spin wait for #IdlePeriods periods, so they are
+	still awake at the forks of the next callbacks and cost no wake up latency. That keeps a core busy while audio is running.
+	Once the callbacks stop, they park on a #Semaphore until #run posts it, the first section after that is usually processed
+	by the calling thread alone.
+
+	Workers are pinned to their own core where the platform allows it. The cores are handed out process wide, see #claimCore,
+	so the workers of several pools, e.g. the pools of the live and the retired kernel, don't end up on the same core.
+
+	The job state is a single 64 bit word of generation, number of jobs and next job index. Jobs are claimed with a compare and swap
+	that fails as soon as the generation changed, so a worker that wakes up late can't claim a job of the next section.
+*/
+class ForkJoinPool
+{
+public:
+	/**
+		Maximum number of jobs per #run.
+	*/
+	static const unsigned int MaxNumJobs = 0xFFFF;
+
+	/**
+		Number of periods an idle worker spins before it parks. Covers the jitter of the host callbacks.
+	*/
+	static const unsigned int IdlePeriods = 2;
+
+	/**
+		Creates the pool and starts the workers. Allocates, should not be called from the audio thread.
+		@param numWorkers the number of worker threads, the calling thread of #run comes on top
+		@param periodSeconds the time between two forks of the calling thread, e.g. the block period of the audio callback
+	*/
+	ForkJoinPool(unsigned int numWorkers, double periodSeconds);
+	~ForkJoinPool();
+
+	ForkJoinPool(const ForkJoinPool &) = delete;
+	ForkJoinPool & operator=(const ForkJoinPool &) = delete;
+
+	/**
+		Returns the number of worker threads.
+	*/
+	unsigned int getNumWorkers() const { return static_cast<unsigned int>(threads.size()); }
+
+	/**
+		Calls @p function for the jobs 0..numJobs-1 in parallel and returns when all jobs are done. Doesn't lock or allocate.
+		Only one thread may run jobs at a time.
+		@param numJobs the number of jobs, <= MaxNumJobs
+		@param function the job, called as function(unsigned int job). Has to stay valid until #run returns.
+	*/
+	template<typename Function>
+	inline void run(unsigned int numJobs, Function & function);
+
+private:
+
+	/**
+		The worker thread loop.
+	*/
+	void workerLoop(unsigned int index);
+
+	/**
+		Claims and runs jobs of @p generation until there are none left.
+	*/
+	void processJobs(uint32_t generation);
+
+	/**
+		Waits a short moment, lets the core know it spins.
+	*/
+	static inline void pause();
+
+	/**
+		Claims a core no other worker of the process is pinned to, from the last core down.
+		@return the core index, -1 if all cores are taken
+	*/
+	static int claimCore();
+
+	/**
+		Returns a core claimed by #claimCore.
+	*/
+	static void releaseCore(int core);
+
+	/**
+		The cores claimed by the workers of all pools.
+	*/
+	struct ClaimedCores
+	{
+		std::mutex mutex;
+		std::vector<bool> claimed;
+	};
+
+	static ClaimedCores & getClaimedCores();
+
+	static inline uint32_t getGeneration(uint64_t state) { return static_cast<uint32_t>(state >> 32); }
+	static inline unsigned int getNumJobs(uint64_t state) { return static_cast<unsigned int>((state >> 16) & 0xFFFF); }
+	static inline unsigned int getNextJob(uint64_t state) { return static_cast<unsigned int>(state & 0xFFFF); }
+
+private:
+
+	// generation, number of jobs and next job index, see the class description
+	std::atomic<uint64_t> state{ 0 };
+	std::atomic<unsigned int> numJobsDone{ 0 };
+
+	// the job of the current generation, written before the state is published
+	void * job{ nullptr };
+	void(*invoke)(void *, unsigned int) { nullptr };
+
+	std::atomic<bool> shouldExit{ false };
+
+	// see the constructor
+	double periodSeconds;
+
+	// parked workers, #run posts wakeUp once for every one of them
+	std::atomic<unsigned int> numParked{ 0 };
+	Semaphore wakeUp;
+
+	std::vector<std::thread> threads;
+};
+
+
+inline ForkJoinPool::ForkJoinPool(unsigned int numWorkers, double periodSeconds) : periodSeconds(periodSeconds)
+{
+	threads.reserve(numWorkers);
+
+	for (unsigned int i = 0; i < numWorkers; i++)
+	{
+		threads.emplace_back([this, i]() { workerLoop(i); });
+	}
+}
+
+inline ForkJoinPool::~ForkJoinPool()
+{
+	shouldExit.store(true);
+
+	for (size_t i = 0; i < threads.size(); i++)
+	{
+		wakeUp.post();
+	}
+
+	for (auto & thread : threads)
+	{
+		thread.join();
+	}
+}
+
+template<typename Function>
+inline void ForkJoinPool::run(unsigned int numJobs, Function & function)
+{
+	assert(numJobs <= MaxNumJobs);
+
+	if (numJobs == 0) return;
+
+	job = &function;
+	invoke = [](void * target, unsigned int index) { (*static_cast<Function*>(target))(index); };
+
+	numJobsDone.store(0, std::memory_order_relaxed);
+
+	// publishing the new generation releases the job to the workers
+	uint32_t generation = getGeneration(state.load(std::memory_order_relaxed)) + 1;
+	state.store((static_cast<uint64_t>(generation) << 32) | (static_cast<uint64_t>(numJobs) << 16), std::memory_order_seq_cst);
+
+	// a worker that parks right now either sees the new generation or is counted here, surplus posts only cause a spurious wake up
+	for (auto numWakeUps = numParked.exchange(0); numWakeUps > 0; numWakeUps--)
+	{
+		wakeUp.post();
+	}
+
+	// takes over every job no worker claimed so far
+	processJobs(generation);
+
+	// join, the remaining jobs were claimed by workers and are running
+	while (numJobsDone.load(std::memory_order_acquire) < numJobs)
+	{
+		pause();
+	}
+}
+
+inline void ForkJoinPool::processJobs(uint32_t generation)
+{
+	auto current = state.load(std::memory_order_acquire);
+
+	while (getGeneration(current) == generation && getNextJob(current) < getNumJobs(current))
+	{
+		// on failure current is reloaded and checked again
+		if (state.compare_exchange_weak(current, current + 1, std::memory_order_acq_rel, std::memory_order_acquire))
+		{
+			// the claim starts the job right away, the generation can't move on before it is done, so the job is still valid
+			invoke(job, getNextJob(current));
+			numJobsDone.fetch_add(1, std::memory_order_release);
+
+			current = state.load(std::memory_order_acquire);
+		}
+	}
+}
+
+inline void ForkJoinPool::workerLoop(unsigned int index)
+{
+	(void)index;
+
+	// without permission the worker keeps its priority and may be preempted during a job the calling thread waits for
+	RealtimeThread::setPriority(periodSeconds);
+
+#if defined(__linux__)
+	// pin the worker to its own core so it doesn't migrate, without a free core it stays unpinned
+	int core = claimCore();
+	if (core >= 0)
+	{
+		cpu_set_t cpuSet;
+		CPU_ZERO(&cpuSet);
+		CPU_SET(core, &cpuSet);
+		pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuSet);
+	}
+#endif
+
+	using Clock = std::chrono::steady_clock;
+
+	// the clock is only read every few pauses
+	const unsigned int NumSpinsPerClockRead = 64;
+
+	auto idleTime = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(IdlePeriods * periodSeconds));
+
+	uint32_t lastGeneration = 0;
+	unsigned int numIdleSpins = 0;
+	auto idleStart = Clock::now();
+
+	while (!shouldExit.load(std::memory_order_relaxed))
+	{
+		uint32_t generation = getGeneration(state.load(std::memory_order_acquire));
+
+		if (generation == lastGeneration)
+		{
+			if (++numIdleSpins % NumSpinsPerClockRead != 0 || Clock::now() - idleStart < idleTime)
+			{
+				pause();
+				continue;
+			}
+
+			// park until the next run, unless it was published in the meantime
+			numParked.fetch_add(1);
+
+			if (getGeneration(state.load()) == lastGeneration && !shouldExit.load())
+			{
+				wakeUp.wait();
+			}
+
+			numIdleSpins = 0;
+			idleStart = Clock::now();
+			continue;
+		}
+
+		lastGeneration = generation;
+
+		processJobs(generation);
+
+		numIdleSpins = 0;
+		idleStart = Clock::now();
+	}
+
+#if defined(__linux__)
+	if (core >= 0) releaseCore(core);
+#endif
+}
+
+inline void ForkJoinPool::pause()
+{
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_IX86)
+	_mm_pause();
+#else
+	std::this_thread::yield();
+#endif
+}
+
+inline ForkJoinPool::ClaimedCores & ForkJoinPool::getClaimedCores()
+{
+	static ClaimedCores claimedCores;
+	return claimedCores;
+}
+
+inline int ForkJoinPool::claimCore()
+{
+	auto & claimedCores = getClaimedCores();
+	std::lock_guard<std::mutex> lock(claimedCores.mutex);
+
+	unsigned int numCores = std::thread::hardware_concurrency();
+	if (numCores < 2) return -1;
+
+	claimedCores.claimed.resize(numCores, false);
+
+	// core 0 is left to the rest of the system
+	for (unsigned int core = numCores - 1; core > 0; core--)
+	{
+		if (!claimedCores.claimed[core])
+		{
+			claimedCores.claimed[core] = true;
+			return static_cast<int>(core);
+		}
+	}
+
+	return -1;
+}
+
+inline void ForkJoinPool::releaseCore(int core)
+{
+	auto & claimedCores = getClaimedCores();
+	std::lock_guard<std::mutex> lock(claimedCores.mutex);
+
+	claimedCores.claimed[core] = false;
+}
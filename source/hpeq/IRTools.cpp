@@ -5,7 +5,262 @@
 
 #include "IRTools.h"
 #include "AFourierTransformFactory.h"
+#include "DSPKernels.h"
 
+#include <list>
+#include <mutex>
+
+
+namespace
+{
+	using Spectrum = std::vector<std::complex<float>>;
+
+	// upper limit for the number of phases of the resampling table, (windowWidth + 1) weights each
+	const unsigned int MaxResamplePhases = 4096;
+
+	/**
+		The most recently used tables of #IRTools::frequencyWeights, shared by all threads.
+	*/
+	struct WeightingTableCache
+	{
+		struct Entry
+		{
+			unsigned int size;
+			float fs;
+			float fHP;
+			float fLP;
+			unsigned int hpfOrder;
+			unsigned int lpfOrder;
+
+			std::shared_ptr<const std::vector<float>> weights;
+		};
+
+		// normalize and fadeOut use two tables per sample rate and size, a few more survive switching back and forth
+		static const unsigned int MaxEntries = 8;
+
+		std::mutex mutex;
+
+		// most recently used first
+		std::list<Entry> entries;
+	};
+
+	WeightingTableCache & getWeightingTableCache()
+	{
+		static WeightingTableCache cache;
+		return cache;
+	}
+
+	// oversampling of the source spectrum that is interpolated by the fast warp
+	const unsigned int WarpOversampling = 16;
+
+	// the fast warp falls back to the exact one for coefficients close to 1, the warped responses get too long
+	const float MaxFastWarpLambda = 0.98f;
+
+	// upper limit for the FFT sizes of the fast warp
+	const unsigned int MaxFastWarpSize = 1 << 22;
+
+	unsigned int gcd(unsigned int a, unsigned int b)
+	{
+		while (b != 0)
+		{
+			auto r = a % b;
+			a = b;
+			b = r;
+		}
+		return a;
+	}
+
+	/**
+		Inverts the magnitude of the non-negative frequency bins, keeps the phase.
+	*/
+	void invertSpectrum(Spectrum & buffer)
+	{
+		for (auto & bin : buffer)
+		{
+			auto ampl = std::abs(bin);
+			if (ampl <  0.0001) ampl = 0.0001; // argh
+			bin /= (ampl * ampl);
+		}
+	}
+
+	/**
+		Fades the magnitude towards the weighted average magnitude at very low and high frequencies, keeps the phase. See #IRTools::fadeOut.
+	*/
+	void fadeOutSpectrum(Spectrum & buffer, unsigned int size, float fs, float fHP, float fLP, unsigned int hpfOrder, unsigned int lpfOrder)
+	{
+		auto weights = IRTools::frequencyWeights(size, fs, fHP, fLP, hpfOrder, lpfOrder);
+
+		// calculate wheighted average over the full spectrum, bins between DC and nyquist appear twice
+		float xSum = 0;
+		float wSum = 0;
+		for (int i = 0; i < buffer.size(); i++)
+		{
+			float w = (*weights)[i];
+			float multiplicity = ((i == 0) || (i == size / 2)) ? 1 : 2;
+
+			auto & bin = buffer[i];
+
+			xSum += multiplicity * std::abs(bin) * w;
+			wSum += multiplicity * w;
+		}
+
+		float average = xSum / wSum;
+
+
+		// fade out frequency response, normalize
+		for (int i = 0; i < buffer.size(); i++)
+		{
+			float w = (*weights)[i];
+
+			auto & bin = buffer[i];
+
+			float mag = w * (std::abs(bin)) + (1 - w) * average;
+
+			bin = std::polar(mag, std::arg(bin));
+		}
+	}
+
+	/**
+		Returns the edges of the smoothing band around frequency f. See #IRTools::SmoothingMode.
+	*/
+	void getSmoothingBand(IRTools::SmoothingMode mode, float width, float f, float & fMin, float & fMax)
+	{
+		switch (mode)
+		{
+		case IRTools::SmoothingMode::ERB:
+		{
+			// Glasberg and Moore equivalent rectangular bandwidth
+			float bandwidth = width * 24.7f * (4.37f * f / 1000.f + 1.f);
+			fMin = std::max(f - 0.5f * bandwidth, 0.f);
+			fMax = f + 0.5f * bandwidth;
+			return;
+		}
+		case IRTools::SmoothingMode::Variable:
+		{
+			// width / 16 below 100 Hz, full width above 10 kHz, log-log in between
+			float position = std::min(std::max(std::log10(std::max(f, 1.f) / 100.f) / 2.f, 0.f), 1.f);
+			width *= std::pow(16.f, position - 1.f);
+			break;
+		}
+		case IRTools::SmoothingMode::Octave:
+			break;
+		}
+
+		fMax = f * std::pow(2., 0.5 * width);
+		fMin = f / std::pow(2., 0.5 * width);
+	}
+
+	/**
+		Smoothes the magnitude with a band around every bin, keeps the phase. See #IRTools::smooth.
+		The band averages come from a prefix sum over the magnitudes, so the cost doesn't depend on the width.
+	*/
+	void smoothSpectrum(Spectrum & buffer, unsigned int size, float fs, IRTools::SmoothingMode mode, float width)
+	{
+		int iNyquist = size / 2;
+
+		// prefix[k] is the sum of the magnitudes of bins 0 .. k-1, double to not loose the small bins at the top of the sum
+		std::vector<double> prefix(iNyquist + 2);
+		for (int k = 0; k <= iNyquist; k++)
+		{
+			prefix[k + 1] = prefix[k] + std::abs(buffer[k]);
+		}
+
+		double magNyquist = prefix[iNyquist + 1] - prefix[iNyquist];
+
+		for (int i = 0; i <= iNyquist; i++)
+		{
+			float f = fs * static_cast<float>(i) / static_cast<float>(size);
+
+			float fMin, fMax;
+			getSmoothingBand(mode, width, f, fMin, fMax);
+
+			int iMin = std::ceil(size  * (fMin / fs));
+			int iMax = iMin + std::floor(size * (fMax - fMin)/fs);
+
+			// bins above nyquist count as the nyquist bin
+			int kMin = std::min(iMin, iNyquist);
+			int kMax = std::min(iMax, iNyquist);
+
+			double sum = prefix[kMax + 1] - prefix[kMin];
+			sum += (iMax - iMin - (kMax - kMin)) * magNyquist;
+
+			sum /= static_cast<double>(iMax - iMin + 1);
+
+			buffer[i] = std::polar(static_cast<float>(sum), std::arg(buffer[i]));
+		}
+	}
+
+	/**
+		Returns the average magnitude used by #IRTools::normalize, weighted with an auditory weighting function for
+		impulse responses longer than 16 samples.
+	*/
+	float getWeightedAverage(const Spectrum & buffer, unsigned int size, float fs)
+	{
+		bool useWeighting = (size > 16);
+
+		std::shared_ptr<const std::vector<float>> weights;
+		if (useWeighting) weights = IRTools::frequencyWeights(size, fs, 50, 20000, 2, 2);
+
+		// calculate wheighted average over the full spectrum, bins between DC and nyquist appear twice
+		float xSum = 0;
+		float wSum = 0;
+		for (int i = 0; i < buffer.size(); i++)
+		{
+			float w = useWeighting ? (*weights)[i] : 1;
+			float multiplicity = ((i == 0) || (i == size / 2)) ? 1 : 2;
+
+			auto & bin = buffer[i];
+
+			xSum += multiplicity * std::abs(bin) * w;
+			wSum += multiplicity * w;
+		}
+
+		return useWeighting ? xSum / wSum : xSum;
+	}
+
+	/**
+		Replaces the spectrum by the minimum phase spectrum with the same magnitude, computed via the real cepstrum.
+		Only needs the cepstral IFFT / FFT pair.
+		@param buffer the non-negative frequency bins
+		@param cepstrum working buffer of the fft size
+		@param transform the fft engine
+	*/
+	void minPhaseSpectrum(Spectrum & buffer, std::vector<float> & cepstrum, AFourierTransform & transform)
+	{
+		unsigned int size = transform.getSize();
+
+		auto minAmp = std::exp(-60);
+
+		// remove phase, limit amplitude, take log
+		for (auto & bin : buffer)
+		{
+			auto ampl = std::abs(bin);
+			if (ampl <  minAmp) ampl = minAmp; // argh
+			bin = std::log(ampl);
+		}
+
+		// iFFT, the log magnitude is real and symmetric, so is the cepstrum
+		transform.performRealIFFT(buffer.data(), cepstrum.data());
+
+		bool isEven = (size % 2) == 0;
+
+		// special sauce mask
+		for (int i = 1; i < cepstrum.size(); i++)
+		{
+			auto gain = (isEven && (i == 0.5*size)) ?  1 :  (((i >= size / 2) ? 0 : 2));
+			cepstrum[i] *= gain;
+		}
+
+		// FFT
+		transform.performRealFFT(cepstrum.data(), buffer.data());
+
+		// exp in FFT
+		for (auto & bin : buffer)
+		{
+			bin = std::exp(bin);
+		}
+	}
+}
 
 
 ImpulseResponse IRTools::resample(const ImpulseResponse & ir, float targetSampleRate, unsigned int windowWidth)
@@ -18,6 +273,13 @@ ImpulseResponse IRTools::resample(const ImpulseResponse & ir, float targetSample
 	unsigned int lengthSource = ir.getSize();
 	unsigned int lengthTarget = std::round(ratio* lengthSource);
 
+	// power of 2 ratios of power of 2 impulse responses, e.g. 48 kHz -> 96 kHz, are resampled in the frequency domain
+	auto octaves = std::log2(ratio);
+	if (isPow2(lengthSource) && lengthSource > 1 && octaves == std::round(octaves) && isPow2(lengthTarget) && lengthTarget > 1)
+	{
+		return resampleSpectrum(ir, targetSampleRate);
+	}
+
 	auto normalizedSampleRate = std::min(ratio, 1.f);
 
 	std::vector<float> buffers[2];
@@ -27,37 +289,139 @@ ImpulseResponse IRTools::resample(const ImpulseResponse & ir, float targetSample
 
 	for (auto c : { 0,1 })
 	{
-		auto & buffer = buffers[c];
-		buffer.resize(lengthTarget);
-		std::fill(buffer.begin(), buffer.end(), 0);
-		const auto &source = ir.getVector(c);
-		
-		for (int i = 0; i < buffer.size(); i++)
+		buffers[c].resize(lengthTarget, 0);
+	}
+
+	auto & kernels = DSPKernels::get();
+
+	// sinc weight of a source sample at distance kRel of the target position, hann windowed over +-windowWidth/2
+	auto getWeight = [&](double kRel)
+	{
+		double w = (std::abs(kRel) <= 0.000001) ? 1. : std::sin(M_PI * kRel * normalizedSampleRate) / (M_PI * kRel * normalizedSampleRate);
+
+		if (useWindowed) w *= (std::abs(kRel) < 0.5 * windowWidth) ? 0.5 * (1. + std::cos(2. * M_PI * kRel / windowWidth)) : 0.;
+
+		return static_cast<float>(w);
+	};
+
+	// without window all source samples contribute
+	int halfTaps = useWindowed ? windowWidth / 2 : lengthSource;
+	int numTaps  = 2 * halfTaps + 1;
+
+	// For sample rates with a small common divisor, e.g. 44.1 kHz <-> 48 kHz, the target positions i * M / L only have
+	// L distinct fractional parts. The weights of all L phases are tabulated once, instead of calling sin and cos per tap.
+	unsigned int phaseL = 0;
+	unsigned int phaseM = 0;
+
+	if (fs == std::round(fs) && tFs == std::round(tFs))
+	{
+		auto divisor = gcd(static_cast<unsigned int>(fs), static_cast<unsigned int>(tFs));
+		phaseL = static_cast<unsigned int>(tFs) / divisor;
+		phaseM = static_cast<unsigned int>(fs)  / divisor;
+	}
+
+	bool usePhaseTable = useWindowed && phaseL > 0 && phaseL < lengthTarget && phaseL <= MaxResamplePhases;
+
+	std::vector<float> phaseTable;
+	if (usePhaseTable)
+	{
+		phaseTable.resize(phaseL * numTaps);
+
+		// row p holds the weights of the taps base - halfTaps .. base + halfTaps for the position base + p / L
+		for (unsigned int p = 0; p < phaseL; p++)
 		{
-			// aligned position of source
-			float kFrac = static_cast<float>(i) / ratio;
-			
-			float kMinFrac = useWindowed ? kFrac - 0.5f*windowWidth :  0;
-			float kMaxFrac = useWindowed ? kFrac + 0.5f*windowWidth : lengthSource-1;
-
-			int kMin = std::max(static_cast<int>(std::floor(kMinFrac)), 0);
-			int kMax = std::min(static_cast<int>(std::ceil(kMaxFrac)), static_cast<int>(lengthSource - 1));
-						
-			for (int k = kMin; k <= kMax; k++)
+			for (int t = 0; t < numTaps; t++)
 			{
-				float kRel = kFrac - k;
-				
-				// sinc weight
-				float w = (std::abs(kRel) <= 0.000001) ? 1.f :  std::sin(M_PI * kRel * normalizedSampleRate) / (M_PI*kRel * normalizedSampleRate);
-
-				// hann window
-				if(useWindowed) w *= 0.5 * (1. - std::cos(2. * M_PI * (k-kMin) / (kMax-kMin+0.0001)));
-				
-				buffer[i] += w * source[k];
+				phaseTable[p * numTaps + t] = getWeight(static_cast<double>(p) / phaseL + halfTaps - t);
 			}
 		}
 	}
 
+	std::vector<float> weights(numTaps);
+
+	for (int i = 0; i < lengthTarget; i++)
+	{
+		// aligned position of source, split in the integer base and the fractional phase
+		int base;
+		const float * rowWeights;
+
+		if (usePhaseTable)
+		{
+			auto position = static_cast<unsigned long long>(i) * phaseM;
+			base = static_cast<int>(position / phaseL);
+
+			rowWeights = phaseTable.data() + (position % phaseL) * numTaps;
+		}
+		else
+		{
+			double kFrac = static_cast<double>(i) / ratio;
+			base = static_cast<int>(std::floor(kFrac));
+
+			for (int t = 0; t < numTaps; t++) weights[t] = getWeight(kFrac - (base - halfTaps + t));
+
+			rowWeights = weights.data();
+		}
+
+		// source samples outside the impulse response are zero
+		int kMin = std::max(base - halfTaps, 0);
+		int kMax = std::min(base + halfTaps, static_cast<int>(lengthSource) - 1);
+
+		if (kMax < kMin) continue;
+
+		for (auto c : { 0,1 })
+		{
+			buffers[c][i] = kernels.dotProduct(rowWeights + (kMin - (base - halfTaps)), ir.getVector(c).data() + kMin, static_cast<unsigned int>(kMax - kMin + 1));
+		}
+	}
+
+	return ImpulseResponse(buffers[0], buffers[1], targetSampleRate);
+}
+
+ImpulseResponse IRTools::resampleSpectrum(const ImpulseResponse & ir, float targetSampleRate)
+{
+	float ratio = targetSampleRate / ir.getSampleRate();
+
+	unsigned int lengthSource = ir.getSize();
+	unsigned int lengthTarget = std::round(ratio * lengthSource);
+
+	assert(isPow2(lengthSource) && isPow2(lengthTarget));
+
+	auto transformSource = AFourierTransformFactory::FourierTransform(staticLog2(lengthSource));
+	auto transformTarget = AFourierTransformFactory::FourierTransform(staticLog2(lengthTarget));
+
+	Spectrum bufferSource(transformSource->getNumRealBins());
+	Spectrum bufferTarget(transformTarget->getNumRealBins());
+
+	// the inverse transform scales by 1 / lengthTarget. Upsampling keeps the amplitude, downsampling keeps the magnitude
+	// response, like the sinc interpolation of #resample
+	float gain = std::max(ratio, 1.f);
+
+	unsigned int numBins = std::min(lengthSource, lengthTarget) / 2;
+
+	std::vector<float> buffers[2];
+
+	for (int c = 0; c < 2; c++)
+	{
+		buffers[c].resize(lengthTarget);
+
+		transformSource->performRealFFT(ir.getChannel(c), bufferSource.data());
+
+		// zero padded or truncated spectrum, the ideal low pass of a band limited interpolation
+		std::fill(bufferTarget.begin(), bufferTarget.end(), std::complex<float>(0));
+		for (unsigned int k = 0; k < numBins; k++)
+		{
+			bufferTarget[k] = gain * bufferSource[k];
+		}
+
+		// upsampling splits the nyquist bin into two halfs, downsampling keeps the real part of the new nyquist bin
+		bufferTarget[numBins] = (lengthTarget > lengthSource) ? 0.5f * gain * bufferSource[numBins] : std::complex<float>(bufferSource[numBins].real());
+
+		transformTarget->performRealIFFT(bufferTarget.data(), buffers[c].data());
+	}
+
+	delete transformSource;
+	delete transformTarget;
+
 	return ImpulseResponse(buffers[0], buffers[1], targetSampleRate);
 }
 
@@ -127,6 +491,11 @@ ImpulseResponse  IRTools::truncate(const ImpulseResponse & ir, float dbThreshold
 }
 
 void IRTools::octaveSmooth(ImpulseResponse & ir, float width)
+{
+	smooth(ir, SmoothingMode::Octave, width);
+}
+
+void IRTools::smooth(ImpulseResponse & ir, SmoothingMode mode, float width)
 {
 	auto fs = ir.getSampleRate();
 	width = std::max(width, 0.f);
@@ -138,69 +507,18 @@ void IRTools::octaveSmooth(ImpulseResponse & ir, float width)
 
 	auto transform = AFourierTransformFactory::FourierTransform(std::log2(size));
 
+	// only the non-negative frequency bins, the rest is conjugate symmetric
+	Spectrum buffer(transform->getNumRealBins());
 
 	for (int c = 0; c < 2; c++)
 	{
-		std::vector<std::complex<float>> buffer;
-		std::vector<std::complex<float>> bufferY;
 		auto x = (c == 0) ? ir.getLeft() : ir.getRight();
 
-		for (int i = 0; i < size; i++)
-		{
-			buffer.push_back(x[i]);
-			bufferY.push_back(0);
-		}
-
-		// FFT
-		transform->performFFTInPlace(buffer.data());
-
-		// calculate wheighted average
-		float xSum = 0;
-		float wSum = 0;
-
-		int iNyquist = buffer.size() / 2;
-		for (int i = 0; i <= iNyquist; i++)
-		{
-			float f = fs * static_cast<float>(i) / static_cast<float>(buffer.size());
-
-			float fMax = f * std::pow(2., 0.5 * width);
-			float fMin = f / std::pow(2., 0.5 * width);
-
-
-			int iMin = std::ceil(buffer.size()  * (fMin / fs));
-			int iMax = iMin + std::floor(buffer.size() * (fMax - fMin)/fs);
-
-			float sum = 0;
-
-			for (int k = iMin; k <= iMax; k++)
-			{
-				float fBin = fs * static_cast<float>(k) / static_cast<float>(buffer.size());
-
-				int   kLim = std::min(std::max(k, 0), iNyquist);
-
-				//float weight = ((fMax - fMin) <= 0.) ? 1. : 0.5 * (1. - std::cos(2. * M_PI*(fBin - fMin) / (fMax - fMin)));
-
-				sum += std::abs(buffer[kLim]);
-			}
-
-			sum /= static_cast<float>((iMax - iMin + 1));
-
-			bufferY[i] = std::polar(sum, std::arg(buffer[i]));
-
-			if ((i != 0) && (i != iNyquist))
-			{
-				bufferY[buffer.size() - i] = std::polar(sum, -std::arg(buffer[i]));
-			}
-		}
-		
-		// iFFT
-		transform->performIFFTInPlace(bufferY.data());
-
-		for (int i = 0; i < size; i++)
-		{
-			x[i] = std::real(bufferY[i]);
-		}
+		transform->performRealFFT(x, buffer.data());
+		smoothSpectrum(buffer, size, fs, mode, width);
+		transform->performRealIFFT(buffer.data(), x);
 	}
+
 	delete transform;
 }
 
@@ -211,44 +529,26 @@ void IRTools::normalize(ImpulseResponse & ir)
 
 	unsigned int size = ir.getSize();
 
-	bool useWeighting = (ir.getSize() > 16);
-
 	auto fs = ir.getSampleRate();
 
 	auto transform = AFourierTransformFactory::FourierTransform(std::log2(size));
 
 	float avg = 0;
+
+	Spectrum buffer(transform->getNumRealBins());
 	
 	for (int c = 0; c < 2; c++)
 	{
-		std::vector<std::complex<float>> buffer;
 		auto x = (c == 0) ? ir.getLeft() : ir.getRight();
-
-		for (int i = 0; i < size; i++)
-		{
-			buffer.push_back(x[i]);
-		}
 		
 		// FFT
-		transform->performFFTInPlace(buffer.data());
-
-		// calculate wheighted average
-		float xSum = 0;
-		float wSum = 0;
-		for (int i = 0; i < buffer.size(); i++)
-		{
-			float f = fs * static_cast<float>(i) / static_cast<float>(buffer.size());
-			float w = useWeighting ? frequencyWeight(f, fs, 50, 20000, 2, 2) : 1;
-
-			auto & bin = buffer[i];
-
-			xSum += std::abs(bin) * w;
-			wSum += w;
-		}				
-		avg += useWeighting ? xSum / wSum : xSum;
+		transform->performRealFFT(x, buffer.data());
 
+		avg += getWeightedAverage(buffer, size, fs);
 	}
 
+	delete transform;
+
 	avg *= 0.5;
 	avg = std::max(avg, 0.0001f);
 
@@ -261,8 +561,6 @@ void IRTools::normalize(ImpulseResponse & ir)
 			x[i] /= avg;
 		}
 	}
-
-	delete transform;
 }
 
 
@@ -277,58 +575,17 @@ void IRTools::fadeOut(ImpulseResponse & ir, float fHP, float fLP, unsigned int h
 
 	auto transform = AFourierTransformFactory::FourierTransform(std::log2(size));
 
+	Spectrum buffer(transform->getNumRealBins());
 
 	for (int c = 0; c < 2; c++)
 	{
-		std::vector<std::complex<float>> buffer;
 		auto x = (c == 0) ? ir.getLeft() : ir.getRight();
 
-		for (int i = 0; i < size; i++)
-		{
-			buffer.push_back(x[i]);
-		}
-
-		// FFT
-		transform->performFFTInPlace(buffer.data());
-
-		// calculate wheighted average
-		float xSum = 0;
-		float wSum = 0;
-		for (int i = 0; i < buffer.size(); i++)
-		{
-			float f = fs * static_cast<float>(i) / static_cast<float>(buffer.size());
-			float w = frequencyWeight(f, fs, fHP, fLP, hpfOrder, lpfOrder);
-
-			auto & bin = buffer[i];
-
-			xSum += std::abs(bin) * w;
-			wSum += w;
-		}
-
-		float average = xSum / wSum;
-
-
-		// fade out frequency response, normalize
-		for (int i = 0; i < buffer.size(); i++)
-		{
-			float f = fs * static_cast<float>(i) / static_cast<float>(buffer.size());
-			float w = frequencyWeight(f, fs, fHP, fLP, hpfOrder, lpfOrder);
-
-			auto & bin = buffer[i];
-
-			float mag = w * (std::abs(bin)) + (1 - w) * average;
-
-			bin = std::polar(mag, std::arg(bin));
-		}
-
-		// iFFT
-		transform->performIFFTInPlace(buffer.data());
-
-		for (int i = 0; i < size; i++)
-		{
-			x[i] = std::real(buffer[i]);
-		}
+		transform->performRealFFT(x, buffer.data());
+		fadeOutSpectrum(buffer, size, fs, fHP, fLP, hpfOrder, lpfOrder);
+		transform->performRealIFFT(buffer.data(), x);
 	}
+
 	delete transform;
 }
 
@@ -340,69 +597,31 @@ void IRTools::makeMinPhase(ImpulseResponse & ir)
 	unsigned int size   = ir.getSize();
 
 	auto transform = AFourierTransformFactory::FourierTransform(std::log2(size));
-	
-	auto minAmp = std::exp(-60);
+
+	// non-negative frequency bins and the real cepstrum
+	Spectrum buffer(transform->getNumRealBins());
+	std::vector<float> cepstrum(size);
 
 	for (int c = 0; c < 2; c++)
 	{
-		std::vector<std::complex<float>> buffer;
 		auto x = (c == 0) ? ir.getLeft() : ir.getRight();
 
-		for (int i = 0; i < size; i++)
-		{
-			buffer.push_back(x[i]);
-		}
-
-		// FFT
-		transform->performFFTInPlace(buffer.data());
-		
-		// remove phase, limit amplitude, take log
-		for (auto & bin : buffer)
-		{
-			auto ampl = std::abs(bin);
-			if (ampl <  minAmp) ampl = minAmp; // argh
-			bin = std::log(ampl);
-		}
-
-		// iFFT
-		transform->performIFFTInPlace(buffer.data());
-		
-		bool isEven = (size % 2) == 0;
-
-		// special sauce mask
-		buffer[0] = std::real(buffer[0]);
-		for (int i = 1; i < buffer.size(); i++)
-		{
-			auto gain = (isEven && (i == 0.5*size)) ?  1 :  (((i >= size / 2) ? 0 : 2));
-			buffer[i] = std::real(buffer[i]) * gain;
-		}
-
-		// FFT
-		transform->performFFTInPlace(buffer.data());
-
-		// exp in FFT
-		for (auto & bin : buffer)
-		{
-			bin = std::exp(bin);
-		}
-
-		// iFFT
-		transform->performIFFTInPlace(buffer.data());
-		
-		for (int i = 0; i < size; i++)
-		{
-			x[i] = std::real(buffer[i]);
-		}
+		transform->performRealFFT(x, buffer.data());
+		minPhaseSpectrum(buffer, cepstrum, *transform);
+		transform->performRealIFFT(buffer.data(), x);
 	}
+
 	delete transform;
 }
 
-ImpulseResponse IRTools::warp(const ImpulseResponse & ir, float lambda, unsigned int len)
+ImpulseResponse IRTools::warp(const ImpulseResponse & ir, float lambda, unsigned int len, bool exact)
 {
 	if (lambda == 0) return ir;
 	std::vector<float> out[2];
 
 	assert((-1 <= lambda) && (lambda <= 1));
+
+	if (!exact && std::abs(lambda) <= MaxFastWarpLambda) return warpSpectrum(ir, lambda, len);
 	
 	for (auto c : { 0,1 })
 	{
@@ -434,6 +653,81 @@ ImpulseResponse IRTools::warp(const ImpulseResponse & ir, float lambda, unsigned
 	return ImpulseResponse(out[0], out[1], ir.getSampleRate());
 }
 
+ImpulseResponse IRTools::warpSpectrum(const ImpulseResponse & ir, float lambda, unsigned int len)
+{
+	// only the first len samples contribute, like in the exact warp
+	unsigned int lengthSource = std::min(ir.getSize(), len);
+
+	// the largest group delay of the allpass stretches the response by (1 + |lambda|) / (1 - |lambda|), the
+	// output FFT has to hold it or the tail aliases into the output
+	double stretch = (1. + std::abs(lambda)) / (1. - std::abs(lambda));
+	auto stretchedSize = static_cast<unsigned int>(std::min(std::ceil(stretch * lengthSource), static_cast<double>(MaxFastWarpSize)));
+
+	unsigned int sizeSource = WarpOversampling * nextPow2(std::max(lengthSource, 2U));
+	unsigned int sizeTarget = std::min(2 * nextPow2(std::max({ len, stretchedSize, 2U })), MaxFastWarpSize);
+
+	auto transformSource = AFourierTransformFactory::FourierTransform(staticLog2(sizeSource));
+	auto transformTarget = AFourierTransformFactory::FourierTransform(staticLog2(sizeTarget));
+
+	std::vector<float> x(sizeSource);
+	std::vector<float> y(sizeTarget);
+
+	Spectrum bufferSource(transformSource->getNumRealBins());
+	Spectrum bufferTarget(transformTarget->getNumRealBins());
+
+	// position of every target bin on the oversampled source spectrum. Replacing z^-1 by the allpass maps frequency w to the
+	// warped frequency -arg(D(e^jw)), the warped response is the source response at the warped frequency
+	std::vector<double> positions(bufferTarget.size());
+	for (unsigned int k = 0; k < positions.size(); k++)
+	{
+		auto zI = std::polar(1., -2. * M_PI * k / sizeTarget);
+		auto allpass = (static_cast<double>(lambda) + zI) / (1. + static_cast<double>(lambda) * zI);
+
+		positions[k] = std::abs(std::arg(allpass)) / (2. * M_PI) * sizeSource;
+	}
+
+	// bins of the real spectrum, continued with conjugate symmetry
+	int iNyquist = sizeSource / 2;
+	auto getBin = [&](int i)
+	{
+		if (i < 0)		  return std::conj(bufferSource[-i]);
+		if (i > iNyquist) return std::conj(bufferSource[2 * iNyquist - i]);
+		return bufferSource[i];
+	};
+
+	std::vector<float> out[2];
+
+	for (int c = 0; c < 2; c++)
+	{
+		std::copy(ir.getChannel(c), ir.getChannel(c) + lengthSource, x.begin());
+		transformSource->performRealFFT(x.data(), bufferSource.data());
+
+		// cubic lagrange interpolation of the oversampled spectrum
+		for (unsigned int k = 0; k < bufferTarget.size(); k++)
+		{
+			int i = static_cast<int>(std::floor(positions[k]));
+			float t = static_cast<float>(positions[k] - i);
+
+			float w0 = -t * (t - 1.f) * (t - 2.f) / 6.f;
+			float w1 = (t + 1.f) * (t - 1.f) * (t - 2.f) / 2.f;
+			float w2 = -(t + 1.f) * t * (t - 2.f) / 2.f;
+			float w3 = (t + 1.f) * t * (t - 1.f) / 6.f;
+
+			bufferTarget[k] = w0 * getBin(i - 1) + w1 * getBin(i) + w2 * getBin(i + 1) + w3 * getBin(i + 2);
+		}
+
+		transformTarget->performRealIFFT(bufferTarget.data(), y.data());
+
+		out[c].assign(len, 0.f);
+		std::copy(y.begin(), y.begin() + std::min(len, sizeTarget), out[c].begin());
+	}
+
+	delete transformSource;
+	delete transformTarget;
+
+	return ImpulseResponse(out[0], out[1], ir.getSampleRate());
+}
+
 void IRTools::invertMagResponse(ImpulseResponse & ir)
 {
 	assert(isPow2(ir.getSize()));
@@ -443,36 +737,76 @@ void IRTools::invertMagResponse(ImpulseResponse & ir)
 
 	auto transform = AFourierTransformFactory::FourierTransform(std::log2(size));
 
+	Spectrum buffer(transform->getNumRealBins());
 
 	for (int c = 0; c < 2; c++)
 	{
-		std::vector<std::complex<float>> buffer;
 		auto x = (c == 0) ? ir.getLeft() : ir.getRight();
 
-		for (int i = 0; i < size; i++)
-		{
-			buffer.push_back(x[i]);
-		}
+		transform->performRealFFT(x, buffer.data());
+		invertSpectrum(buffer);
+		transform->performRealIFFT(buffer.data(), x);
+	}
 
-		// FFT
-		transform->performFFTInPlace(buffer.data());
+	delete transform;
+}
 
-		// remove phase, limit amplitude, take log
-		for (auto & bin : buffer)
+void IRTools::processSpectrum(ImpulseResponse & ir, const SpectralConfig & cfg)
+{
+	assert(isPow2(ir.getSize()));
+	if (ir.getSize() < 2) return;
+
+	bool fadeOut = (cfg.hpfOrder > 0) || (cfg.lpfOrder > 0);
+	bool smooth  = (cfg.smoothWidth > 0);
+
+	if (!cfg.invert && !fadeOut && !smooth && !cfg.normalize && !cfg.makeMinPhase) return;
+
+	unsigned int size = ir.getSize();
+	auto fs = ir.getSampleRate();
+
+	auto transform = AFourierTransformFactory::FourierTransform(std::log2(size));
+
+	// the spectra of both channels are kept, normalization averages over both
+	Spectrum spectra[2];
+	std::vector<float> cepstrum;
+
+	float avg = 0;
+
+	for (int c = 0; c < 2; c++)
+	{
+		auto & buffer = spectra[c];
+		buffer.resize(transform->getNumRealBins());
+
+		transform->performRealFFT(ir.getChannel(c), buffer.data());
+
+		if (cfg.invert) invertSpectrum(buffer);
+		if (fadeOut)	fadeOutSpectrum(buffer, size, fs, cfg.fHP, cfg.fLP, cfg.hpfOrder, cfg.lpfOrder);
+		if (smooth)		smoothSpectrum(buffer, size, fs, cfg.smoothMode, cfg.smoothWidth);
+
+		if (cfg.normalize) avg += getWeightedAverage(buffer, size, fs);
+	}
+
+	// scaling the spectrum equals scaling the impulse response and commutes with the min phase conversion
+	float gain = cfg.normalize ? 1.f / std::max(0.5f * avg, 0.0001f) : 1.f;
+
+	for (int c = 0; c < 2; c++)
+	{
+		auto & buffer = spectra[c];
+
+		if (gain != 1.f)
 		{
-			auto ampl = std::abs(bin);
-			if (ampl <  0.0001) ampl = 0.0001; // argh
-			bin /= (ampl * ampl);
+			for (auto & bin : buffer) bin *= gain;
 		}
 
-		// iFFT
-		transform->performIFFTInPlace(buffer.data());
-		
-		for (int i = 0; i < size; i++)
+		if (cfg.makeMinPhase)
 		{
-			x[i] = std::real(buffer[i]);
+			cepstrum.resize(size);
+			minPhaseSpectrum(buffer, cepstrum, *transform);
 		}
+
+		transform->performRealIFFT(buffer.data(), ir.getChannel(c));
 	}
+
 	delete transform;
 }
 
@@ -510,6 +844,40 @@ bool IRTools::isPow2(unsigned int x)
 	return x == nextPow2(x);
 }
 
+std::shared_ptr<const std::vector<float>> IRTools::frequencyWeights(unsigned int size, float fs, float fHP, float fLP, unsigned int hpfOrder, unsigned int lpfOrder)
+{
+	auto & cache = getWeightingTableCache();
+
+	{
+		std::lock_guard<std::mutex> lock(cache.mutex);
+
+		for (auto entry = cache.entries.begin(); entry != cache.entries.end(); entry++)
+		{
+			if (entry->size == size && entry->fs == fs && entry->fHP == fHP && entry->fLP == fLP && entry->hpfOrder == hpfOrder && entry->lpfOrder == lpfOrder)
+			{
+				cache.entries.splice(cache.entries.begin(), cache.entries, entry);
+				return entry->weights;
+			}
+		}
+	}
+
+	// calculated outside the lock, two threads missing the same table both calculate it
+	auto weights = std::make_shared<std::vector<float>>(size / 2 + 1);
+
+	for (unsigned int i = 0; i < weights->size(); i++)
+	{
+		float f = fs * static_cast<float>(i) / static_cast<float>(size);
+		(*weights)[i] = frequencyWeight(f, fs, fHP, fLP, hpfOrder, lpfOrder);
+	}
+
+	std::lock_guard<std::mutex> lock(cache.mutex);
+
+	cache.entries.push_front({ size, fs, fHP, fLP, hpfOrder, lpfOrder, weights });
+	if (cache.entries.size() > WeightingTableCache::MaxEntries) cache.entries.pop_back();
+
+	return weights;
+}
+
 float IRTools::frequencyWeight(float f, float fs, float fHP, float fLP, unsigned int hpfOrder, unsigned int lpfOrder)
 {
 	std::complex<double> z = std::polar(1., 2.f * M_PI * f / fs);
@@ -2,6 +2,8 @@
 
 
 #include "ImpulseResponse.h"
+#include <memory>
+#include <vector>
 
 
 
@@ -15,7 +17,8 @@ namespace IRTools
 
 	/**
 		Function resamples the impulse response. The implementation uses a sinc convolution approach. The concolution is windowed using a hanning window
-		if the impulse response is longer then windowWidth. 
+		if the impulse response is longer then windowWidth. For integer sample rates the windowed sinc is tabulated for every phase of the
+		polyphase decomposition. Power of 2 impulse responses and power of 2 ratios are resampled with #resampleSpectrum.
 		@param ir the impulse response
 		@param targetSampleRate the targeted sample rate
 		@param windowWidth returns the width of the hanning window. If the impulse response is shorter then the window width, no window will be used
@@ -24,6 +27,15 @@ namespace IRTools
 	*/
 	ImpulseResponse resample(const ImpulseResponse & ir, float targetSampleRate, unsigned int windowWidth = 64);
 
+	/**
+		Function resamples the impulse response in the frequency domain by zero padding or truncating its spectrum, an ideal low pass
+		interpolation. The impulse response is treated as periodic. Used by #resample for power of 2 ratios.
+		@param ir the impulse response, has to be of size N = 2^n
+		@param targetSampleRate the targeted sample rate, the ratio to the current sample rate has to be a power of 2
+		@return the resampled impulse response
+	*/
+	ImpulseResponse resampleSpectrum(const ImpulseResponse & ir, float targetSampleRate);
+
 	/**
 		Function converts the impulse response to a monophonic IR using the average of both channels.
 		@param ir the impulse response
@@ -47,6 +59,30 @@ namespace IRTools
 	*/
 	void octaveSmooth(ImpulseResponse & ir, float width);
 
+	/**
+		The bandwidth used by #smooth.
+	*/
+	enum class SmoothingMode
+	{
+		// constant width in octaves
+		Octave,
+
+		// width in equivalent rectangular bandwidths of the auditory filters
+		ERB,
+
+		// width / 16 octaves below 100 Hz growing to width octaves at 10 kHz, keeps the low frequency detail
+		Variable
+	};
+
+	/**
+		Function smoothes the magnitude response, the phase is kept. Runs in linear time independent of the width.
+		Only works with impulse responses with size 2^n.
+		@param ir		the impulse response
+		@param mode		the bandwidth of the smoothing kernel
+		@param width	kernel width in octaves or ERBs, see #SmoothingMode
+	*/
+	void smooth(ImpulseResponse & ir, SmoothingMode mode, float width);
+
 	/**
 		Function normalizes the frequency responses average magnitude response using a auditory weighting function similar to C-weighting.
 		Only works with impulse responses with size 2^n.
@@ -77,9 +113,22 @@ namespace IRTools
 		@param ir the original impulse response
 		@param lambda allpass / warping coefficient lambda
 		@param len length of the output impulse response
+		@param exact if true, the warped response is calculated sample by sample with a cascade of allpass filters, O(len^2).
+		Otherwise #warpSpectrum is used for |lambda| <= 0.98
+		@return the warped impulse response
+	*/
+	ImpulseResponse warp(const ImpulseResponse & ir, float lambda, unsigned int len, bool exact = false);
+
+	/**
+		Function warps the impulse response in the frequency domain: the warped frequency response is the original response,
+		interpolated from an oversampled spectrum at the frequencies mapped by the allpass. Runs in O(len log len), the
+		result matches #warp with exact = true up to the interpolation error and the aliased tail beyond the FFT size.
+		@param ir the original impulse response
+		@param lambda allpass / warping coefficient lambda, |lambda| < 1
+		@param len length of the output impulse response
 		@return the warped impulse response
 	*/
-	ImpulseResponse warp(const ImpulseResponse & ir, float lambda, unsigned int len);
+	ImpulseResponse warpSpectrum(const ImpulseResponse & ir, float lambda, unsigned int len);
 
 
 	/**
@@ -89,6 +138,41 @@ namespace IRTools
 	*/
 	void invertMagResponse(ImpulseResponse & ir);
 
+	/**
+		The spectral stages of #processSpectrum. Stages are skipped if disabled or set to zero.
+	*/
+	struct SpectralConfig
+	{
+		// see #invertMagResponse
+		bool invert{ false };
+
+		// see #fadeOut, the fade is skipped if both orders are zero
+		float fHP{ 0 };
+		float fLP{ 0 };
+		unsigned int hpfOrder{ 0 };
+		unsigned int lpfOrder{ 0 };
+
+		// see #smooth
+		SmoothingMode smoothMode{ SmoothingMode::Octave };
+		float smoothWidth{ 0 };
+
+		// see #normalize
+		bool normalize{ false };
+
+		// see #makeMinPhase
+		bool makeMinPhase{ false };
+	};
+
+	/**
+		Function applies #invertMagResponse, #fadeOut, #smooth, #normalize and #makeMinPhase in this order, but transforms
+		every channel only once: all stages work on the shared spectrum and the result is transformed back once. The min phase
+		conversion only adds its cepstral FFT pair. The result equals calling the functions one after the other.
+		Only works with impulse responses with size 2^n.
+		@param ir the impulse response, must be of size N=2^n
+		@param cfg the stages to apply
+	*/
+	void processSpectrum(ImpulseResponse & ir, const SpectralConfig & cfg);
+
 
 	/**
 		Function zero pads to get an size 2^n impulse response.
@@ -126,6 +210,19 @@ namespace IRTools
 	*/
 	float frequencyWeight(float f, float fs, float fHP, float fLP, unsigned int hpfOrder, unsigned int lpfOrder);
 
+	/**
+		Function returns #frequencyWeight for the bins 0 .. N/2 of a N point FFT. The last few tables are cached and shared between
+		calls and threads, so repeated pre processing runs with the same sample rate, size and filters don't calculate them again.
+		@param size			the FFT size N
+		@param fs			the sample rate
+		@param fHP			highpass frequency
+		@param fLP			lowpass frequency
+		@param hpfOrder		the order of the highpass filters
+		@param lpfOrder		the order of the lowpass filters
+		@return the N/2 + 1 weights, immutable
+	*/
+	std::shared_ptr<const std::vector<float>> frequencyWeights(unsigned int size, float fs, float fHP, float fLP, unsigned int hpfOrder, unsigned int lpfOrder);
+
 	
 	/**
 		A simple first order allpass filter implementation. With coeff c, filter response is
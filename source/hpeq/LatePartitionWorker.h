@@ -0,0 +1,288 @@
+#pragma once
+
+#include "PartitionedKernel.h"
+#include "SPSCQueue.h"
+#include "Semaphore.h"
+#include "RealtimeThread.h"
+#include <thread>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+
+/**
+	Computes the late partitions of a uniformly partitioned convolution on a dedicated worker thread.
+
+	The late partitions p >= Delay of output block m only depend on the input spectra X_{m-Delay} and older. The audio thread
+	hands the input spectrum of block m to the worker with #setInput and #submit, the worker multiplies it with the late partitions
+	and sends back the late part of block m + Delay. The worker has a deadline of Delay partition periods, the audio thread
+	only computes the first Delay partitions itself and adds the late result with #addResult.
+
+	Spectra flow through two #SPSCQueue, the worker owns the late frequency delay line, so neither side locks. The worker runs with
+	real time priority where permitted and is woken with a #Semaphore, posting it doesn't lock.
+
+	The audio thread never waits for the worker. Every block carries its block index. If the late part of a block isn't there in time,
+	#addResult leaves it out and reports the miss, the result arriving later is dropped. If the worker is so far behind that the input
+	queue is full, the input block is dropped and the worker continues with silence in its place, so the delay line stays aligned.
+
+	Created by the pre processor, the thread is joined when the worker is destroyed.
+*/
+class LatePartitionWorker
+{
+public:
+	/**
+		Number of partitions computed by the audio thread, and the number of blocks the worker may lag behind.
+	*/
+	static const unsigned int Delay = 2;
+
+	/**
+		Number of blocks the input queue holds on top of the Delay blocks in flight before input blocks are dropped.
+	*/
+	static const unsigned int MaxBacklog = 8;
+
+	/**
+		Creates the late partitions and starts the worker thread. Allocates, should not be called from the audio thread.
+		@param ir the impulse response
+		@param partSize the partition size, has to be a power of 2
+	*/
+	LatePartitionWorker(const ImpulseResponse & ir, unsigned int partSize);
+	~LatePartitionWorker();
+
+	LatePartitionWorker(const LatePartitionWorker &) = delete;
+	LatePartitionWorker & operator=(const LatePartitionWorker &) = delete;
+
+	/**
+		Stores the input spectrum of the current block for the next #submit. Audio thread only.
+		@param channel the channel index
+		@param spectrum the N+1 bins of the input spectrum
+	*/
+	inline void setInput(unsigned int channel, const std::complex<float> * spectrum);
+
+	/**
+		Hands the input spectra of the current block to the worker. Audio thread only.
+	*/
+	inline void submit();
+
+	/**
+		Adds the late part of the current output block to @p outL and @p outR if the worker finished it, never waits. Audio thread only.
+		@param outL, outR the N+1 bins of the output spectra
+		@return false if the worker missed the deadline and the block has no late part
+	*/
+	inline bool addResult(std::complex<float> * outL, std::complex<float> * outR);
+
+private:
+
+	/**
+		The worker thread loop.
+	*/
+	void run();
+
+	/**
+		Block index tag in the first element of a queued block.
+	*/
+	static inline void setTag(std::complex<float> * frame, uint64_t index);
+	static inline uint64_t getTag(const std::complex<float> * frame);
+
+private:
+	PartitionedKernel kernel;
+
+	// complex bins of both channels per block, 2 * numBins
+	unsigned int blockSize{ 0 };
+
+	// queued block, the tag followed by the bins
+	unsigned int frameSize{ 0 };
+
+	// period of a block, for the real time scheduling
+	double blockPeriod{ 0 };
+
+	SPSCQueue<std::complex<float>> inputQueue;
+	SPSCQueue<std::complex<float>> resultQueue;
+
+	// transfer frames of the audio thread, frameSize
+	std::vector<std::complex<float>> audioInput;
+	std::vector<std::complex<float>> audioResult;
+
+	// index of the next submitted input block and of the next output block, audio thread only
+	uint64_t audioInputIndex{ 0 };
+	uint64_t audioOutputIndex{ 0 };
+
+	// audioResult holds a pulled result of a later block, audio thread only
+	bool audioResultPending{ false };
+
+	// working frames of the worker thread, frameSize
+	std::vector<std::complex<float>> workerInput;
+	std::vector<std::complex<float>> workerResult;
+
+	// input spectrum that stands in for dropped input blocks, numBins
+	std::vector<std::complex<float>> workerSilence;
+
+	// index of the next input block the worker expects, worker thread only
+	uint64_t workerInputIndex{ 0 };
+
+	std::atomic<bool> shouldExit{ false };
+	Semaphore wakeUp;
+
+	std::thread thread;
+};
+
+
+inline LatePartitionWorker::LatePartitionWorker(const ImpulseResponse & ir, unsigned int partSize)
+{
+	kernel = PartitionedKernel::create(ir, partSize, Delay * partSize);
+
+	blockSize = 2 * kernel.numBins;
+	frameSize = blockSize + 1;
+
+	blockPeriod = partSize / static_cast<double>(ir.getSampleRate());
+
+	inputQueue.setSize(IRTools::nextPow2((Delay + MaxBacklog) * frameSize));
+
+	// a worker catching up pushes the results of all queued inputs at once, on top of the results in flight
+	unsigned int numInputFrames = inputQueue.getNumFree() / frameSize;
+	resultQueue.setSize(IRTools::nextPow2((numInputFrames + Delay + 1) * frameSize));
+
+	audioInput.resize(frameSize);
+	audioResult.resize(frameSize);
+	workerInput.resize(frameSize);
+	workerResult.resize(frameSize);
+	workerSilence.resize(kernel.numBins);
+
+	// the first Delay output blocks have no late part
+	for (unsigned int i = 0; i < Delay; i++)
+	{
+		setTag(workerResult.data(), i);
+		resultQueue.push(workerResult.data(), frameSize);
+	}
+
+	thread = std::thread([this]() { run(); });
+}
+
+inline LatePartitionWorker::~LatePartitionWorker()
+{
+	shouldExit.store(true);
+	wakeUp.post();
+
+	if (thread.joinable()) thread.join();
+}
+
+inline void LatePartitionWorker::setInput(unsigned int channel, const std::complex<float> * spectrum)
+{
+	std::copy(spectrum, spectrum + kernel.numBins, audioInput.begin() + 1 + channel * kernel.numBins);
+}
+
+inline void LatePartitionWorker::submit()
+{
+	setTag(audioInput.data(), audioInputIndex++);
+
+	// a worker lagging more than the backlog loses this block, it stands in silence for it
+	if (inputQueue.getNumFree() >= frameSize)
+	{
+		inputQueue.push(audioInput.data(), frameSize);
+	}
+
+	wakeUp.post();
+}
+
+inline bool LatePartitionWorker::addResult(std::complex<float> * outL, std::complex<float> * outR)
+{
+	uint64_t index = audioOutputIndex++;
+
+	while (true)
+	{
+		if (!audioResultPending)
+		{
+			if (resultQueue.getNumReady() < frameSize) break;
+
+			resultQueue.pull(audioResult.data(), frameSize);
+			audioResultPending = true;
+		}
+
+		auto resultIndex = getTag(audioResult.data());
+
+		// the late result of a block that already went out without it
+		if (resultIndex < index)
+		{
+			audioResultPending = false;
+			continue;
+		}
+
+		// the result of a later block, this block's input was dropped. Kept for its block
+		if (resultIndex > index) break;
+
+		audioResultPending = false;
+
+		auto numBins = kernel.numBins;
+		auto result = audioResult.data() + 1;
+
+		for (unsigned int i = 0; i < numBins; i++)
+		{
+			outL[i] += result[i];
+			outR[i] += result[numBins + i];
+		}
+
+		return true;
+	}
+
+	// deadline missed, the block goes out without its late part
+	return false;
+}
+
+inline void LatePartitionWorker::run()
+{
+	RealtimeThread::setPriority(blockPeriod);
+
+	auto numBins = kernel.numBins;
+
+	while (true)
+	{
+		wakeUp.wait();
+
+		if (shouldExit.load()) return;
+
+		while (inputQueue.getNumReady() >= frameSize)
+		{
+			inputQueue.pull(workerInput.data(), frameSize);
+
+			auto inputIndex = getTag(workerInput.data());
+
+			// dropped input blocks, silence keeps the delay line aligned. Their results are missing anyway
+			while (workerInputIndex < inputIndex)
+			{
+				for (unsigned int c : {0, 1}) kernel.setInputFFT(c, workerSilence.data());
+				kernel.advance();
+
+				workerInputIndex++;
+			}
+
+			// the late partitions start at Delay, so the latest input already belongs to output block m + Delay
+			for (unsigned int c : {0, 1})
+			{
+				kernel.setInputFFT(c, workerInput.data() + 1 + c * numBins);
+				kernel.accumulateSpectrum(c, workerResult.data() + 1 + c * numBins);
+			}
+			kernel.advance();
+
+			workerInputIndex++;
+
+			// a full queue only holds results the audio thread didn't get to discard yet, this block then counts as missed
+			setTag(workerResult.data(), inputIndex + Delay);
+			if (resultQueue.getNumFree() >= frameSize)
+			{
+				resultQueue.push(workerResult.data(), frameSize);
+			}
+		}
+	}
+}
+
+inline void LatePartitionWorker::setTag(std::complex<float> * frame, uint64_t index)
+{
+	static_assert(sizeof(std::complex<float>) == sizeof(uint64_t), "the tag fills one complex sample");
+	std::memcpy(static_cast<void*>(frame), &index, sizeof(index));
+}
+
+inline uint64_t LatePartitionWorker::getTag(const std::complex<float> * frame)
+{
+	uint64_t index;
+	std::memcpy(&index, static_cast<const void*>(frame), sizeof(index));
+	return index;
+}
@@ -18,16 +18,17 @@ void ParFiltConvolution::process(const float * readL, const float * readR, float
 	updateData();
 	auto bank = getData();
 
+	// the mono input is cached in the left output, the fir output in the right output, buffers might be the same
 	for (int i = 0; i < numSamples; i++)
 	{
-		auto in = 0.5f * (readL[i] + readR[i]);
-		float out = bank->firFilter.tick(in);
-		for (auto &filter : bank->parallelFilters)
-		{
-			out += filter.tick(in);
-		}
-		writeL[i] = writeR[i] = out;
+		writeL[i] = 0.5f * (readL[i] + readR[i]);
+		writeR[i] = bank->firFilter.tick(writeL[i]);
 	}
+
+	// add all second order sections at once
+	bank->parallelBank.process(DSPKernels::get(), writeL, writeR, numSamples);
+
+	std::copy(writeR, writeR + numSamples, writeL);
 }
 
 void ParFiltConvolution::setWarpCoefficient(float lambda)
@@ -35,6 +36,11 @@ void ParFiltConvolution::setWarpCoefficient(float lambda)
 	this->lambda = std::min(std::max(lambda, 0.f), 1.f);
 }
 
+unsigned int ParFiltConvolution::getTailSamples() const
+{
+	return std::min(getImpulseResponse()->getSize(), static_cast<unsigned int>(MaxInputFIRSize));
+}
+
 void ParFiltConvolution::setFilterBankSize(unsigned int numSOSFilters, unsigned int firOrder)
 {
 	this->numSOSSections = std::max(1U, numSOSFilters);
@@ -302,6 +308,7 @@ FilterBank ParFiltConvolution::approximateIR(std::vector<double> ir, std::vector
 
 	FilterBank fiterBank;
 	fiterBank.parallelFilters = secondOrderSections;
+	fiterBank.parallelBank.setFilters(secondOrderSections);
 
 	if (firCoefficeints > 0)
 	{
@@ -7,6 +7,8 @@
 
 #include "ASyncedConvolutionEngine.h"
 #include "ThreadSyncable.h"
+#include "AlignedAllocator.h"
+#include "DSPKernels.h"
 
 namespace
 {
@@ -105,6 +107,28 @@ namespace
 
 	};
 
+	/**
+		The parallel second order sections in a structure of arrays layout so that the bank can be processed
+		with #DSPKernels::KernelTable::parallelSOS. The bank is padded with silent sections to a multiple of 16.
+	*/
+	struct ParallelSOSBank
+	{
+		/**
+			Copies the coefficients of @p filters and resets the states. Allocates memory.
+		*/
+		inline void setFilters(std::vector<SOS<float>> & filters);
+
+		/**
+			Processes @p numSamples samples and adds the bank output to @p out.
+		*/
+		inline void process(const DSPKernels::KernelTable & kernels, const float * in, float * out, unsigned int numSamples);
+
+		unsigned int numSections{ 0 };
+
+		AlignedVector<float> b0, b1, b2, a1, a2;
+		AlignedVector<float> z1, z2;
+	};
+
 	/**
 		A small unility class that contains filters to be used during processing.
 	*/
@@ -112,6 +136,9 @@ namespace
 	{
 		std::vector<SOS<float>> parallelFilters;
 
+		// the coefficients of parallelFilters as used during processing
+		ParallelSOSBank parallelBank;
+
 		FIRFilter<float, 16> firFilter;
 	};
 
@@ -152,6 +179,11 @@ public:
 	*/
 	void setFilterBankSize(unsigned int numSOSFilters, unsigned int firOrder);
 
+	/**
+		Returns the size of the approximated impulse response, which is truncated to #MaxInputFIRSize. The filter bank has no latency.
+	*/
+	virtual unsigned int getTailSamples() const override;
+
 	/**
 		Creates a new filter bank with given @p lambda and @p numSOSFilters. The function is static to help with
 		multi threading robustness. 
@@ -262,4 +294,32 @@ inline void FIRFilter<T, MaxOrder>::setCoeffs(Coeffs coeffs)
 	curOrder = MaxOrder;
 	while (curOrder > 0 && (coeffs.b[curOrder] == 0)) curOrder--;
 	curOrder = std::max(curOrder, 1U);
-}
\ No newline at end of file
+}
+
+inline void ParallelSOSBank::setFilters(std::vector<SOS<float>> & filters)
+{
+	numSections = (static_cast<unsigned int>(filters.size()) + 15) & ~15U;
+
+	// padded sections have zero coefficients and stay silent
+	for (auto vec : { &b0, &b1, &b2, &a1, &a2, &z1, &z2 })
+	{
+		vec->assign(numSections, 0.f);
+	}
+
+	for (unsigned int s = 0; s < filters.size(); s++)
+	{
+		auto coeffs = filters[s].getCoeffs();
+		b0[s] = coeffs.b0;
+		b1[s] = coeffs.b1;
+		b2[s] = coeffs.b2;
+		a1[s] = coeffs.a1;
+		a2[s] = coeffs.a2;
+	}
+}
+
+inline void ParallelSOSBank::process(const DSPKernels::KernelTable & kernels, const float * in, float * out, unsigned int numSamples)
+{
+	if (numSections == 0) return;
+
+	kernels.parallelSOS(b0.data(), b1.data(), b2.data(), a1.data(), a2.data(), z1.data(), z2.data(), numSections, in, out, numSamples);
+}
@@ -0,0 +1,375 @@
+#pragma once
+
+#include "ImpulseResponse.h"
+#include "AFourierTransformFactory.h"
+#include "IRTools.h"
+#include "AlignedAllocator.h"
+#include "DSPKernels.h"
+#include "ForkJoinPool.h"
+#include <vector>
+#include <memory>
+#include <algorithm>
+
+/**
+	Contains the fourier transformed, uniformly partitioned impulse response and the frequency domain delay line
+	discussed in Eric Battenberg, Rimas Avizienis 2011. Every partition of size N is transformed with a real valued 2N FFT
+	and stored as N+1 bins.
+
+	Spectra are stored in a split layout with real and imaginary parts in seperate, aligned arrays so that the multiply accumulate
+	of all partitions runs vectorized, see #DSPKernels. Every partition is padded to a multiple of 16 bins.
+
+	The kernel is created by the pre processor so that the audio thread only has to swap it in. It owns the FFT instance
+	used to transform the input, so all memory is allocated on the pre processor thread and scales with the partition size.
+*/
+struct PartitionedKernel
+{
+	/**
+		Creates the partitioned kernel. Allocates memory and performs one FFT per partition, should not be called from the audio thread.
+		@param ir the impulse response
+		@param partSize the partition size, has to be a power of 2
+		@param offset position of the first partition in the impulse response
+		@param numPartitions the number of partitions. If 0, the partitions cover the impulse response from @p offset to its end.
+		@return the partitioned kernel
+	*/
+	static inline PartitionedKernel create(const ImpulseResponse & ir, unsigned int partSize, unsigned int offset = 0, unsigned int numPartitions = 0);
+
+	/**
+		Writes the spectrum of the latest input block to the current delay line slot.
+		@param channel the channel index
+		@param spectrum the N+1 bins of the input spectrum
+	*/
+	inline void setInputFFT(unsigned int channel, const std::complex<float> * spectrum);
+
+	/**
+		Multiplies every partition with its delayed input spectrum and sums up the products.
+		@param channel the channel index
+		@param out the N+1 bins of the convolution output
+	*/
+	inline void accumulateSpectrum(unsigned int channel, std::complex<float> * out);
+
+	/**
+		Multiplies every partition with its delayed input spectrum and sums up the products for a range of bins only,
+		so that the work can be split up.
+		@param channel the channel index
+		@param out the N+1 bins of the convolution output, only the bins in the range are written
+		@param firstBin the first bin of the range, has to be a multiple of 16
+		@param endBin the end of the range, <= binStride
+	*/
+	inline void accumulateSpectrum(unsigned int channel, std::complex<float> * out, unsigned int firstBin, unsigned int endBin);
+
+	/**
+		Moves the delay line by one partition. Has to be called after all channels were processed.
+		The channels themselves don't share any state and may be processed on different threads.
+	*/
+	inline void advance();
+
+
+	// size of the partitions, the fft size is twice the partition size
+	unsigned int partSize{ 0 };
+	unsigned int fftOrder{ 0 };
+
+	// fft engine of order fftOrder, not thread safe, only used by the thread that processes the kernel
+	std::shared_ptr<AFourierTransform> fft;
+
+	unsigned int numPartitions{ 0 };
+
+	// number of bins per partition, partSize + 1
+	unsigned int numBins{ 0 };
+
+	// distance between two partitions in the split spectra, numBins rounded up to a multiple of 16
+	unsigned int binStride{ 0 };
+
+	// fft's of the partitions, partition p is stored at index p * binStride
+	AlignedVector<float> kernelFFTsRe[2];
+	AlignedVector<float> kernelFFTsIm[2];
+
+	// frequency domain delay line with the same layout as kernelFFTs
+	AlignedVector<float> partitionFFTCacheRe[2];
+	AlignedVector<float> partitionFFTCacheIm[2];
+
+	// accumulates the products of all partitions per channel, binStride
+	AlignedVector<float> accumulatorRe[2];
+	AlignedVector<float> accumulatorIm[2];
+
+	// index of the current partition in partitionFFTCache
+	unsigned int currentPartition{ 0 };
+};
+
+/**
+	A #PartitionedKernel together with the overlap add accumulator of the uniformly partitioned engines.
+*/
+struct UniformPartitionedKernel : public PartitionedKernel
+{
+	// number of bin ranges the multiply accumulate of a channel is split into with balanced scheduling
+	static const unsigned int NumMACStages = 8;
+
+	// stages per block with balanced scheduling: fft per channel, NumMACStages per channel, ifft per channel
+	static const unsigned int NumStages = 4 + 2 * NumMACStages;
+
+	/**
+		Creates the partitioned kernel with an empty accumulator and the working buffers.
+		@param ir the impulse response
+		@param partSize the partition size, has to be a power of 2
+		@param numPartitions the number of partitions. If 0, the partitions cover the full impulse response.
+		@param balanced true to allocate the buffers of the balanced scheduling, see #balanced
+	*/
+	static inline UniformPartitionedKernel create(const ImpulseResponse & ir, unsigned int partSize, unsigned int numPartitions = 0, bool balanced = false);
+
+	/**
+		Returns the bin range of a multiply accumulate stage, see #accumulateSpectrum.
+		@param stage the stage index, 0..NumMACStages-1
+		@param firstBin returns the first bin of the range
+		@param endBin returns the end of the range, equals firstBin if the stage has no bins
+	*/
+	inline void getMACStageRange(unsigned int stage, unsigned int & firstBin, unsigned int & endBin) const;
+
+	/**
+		Starts the worker that processes one channel while the audio thread processes the other, see #forEachChannel.
+		Does nothing on single core machines. Allocates, should not be called from the audio thread.
+		@param periodSeconds the time between two calls of #forEachChannel, see #ForkJoinPool
+	*/
+	inline void createChannelWorker(double periodSeconds);
+
+	/**
+		Calls @p function(channel) for both channels, in parallel if a channel worker exists. Doesn't lock or allocate.
+	*/
+	template<typename Function>
+	inline void forEachChannel(Function && function);
+
+	/**
+		Zero pads the queued input of a channel, transforms it and writes it to the delay line. Leaves the spectrum in outputFFT.
+	*/
+	inline void transformInput(unsigned int channel);
+
+	/**
+		Transforms outputFFT of a channel back to time domain and overlap adds it to the output accumulator.
+	*/
+	inline void transformOutput(unsigned int channel);
+
+	// overlap add accumulator, the first half is the output block currently written to the output,
+	// the second half is the tail of the last convolution that will be added to the next output block
+	std::vector<float> outputAccumulator[2];
+
+	// caches the input samples, zero padded, and the convolution output, 2 * partSize
+	std::vector<float> audioInput[2];
+
+	// spectrum of the convolution output, numBins
+	std::vector<std::complex<float>> outputFFT[2];
+
+	// with balanced scheduling, a full input block is processed in NumStages stages spread over the next partition period
+	// instead of all at once, the latency grows by one partition. Every FFT and IFFT is a single unsplit stage, so the peak load
+	// per callback is at least one 2 * partSize transform, about a quarter of the block when the transforms dominate.
+	bool balanced{ false };
+
+	// the block processed by the balanced scheduling, zero padded, and its convolution output, 2 * partSize
+	std::vector<float> pendingBlock[2];
+
+	// number of stages of the pending block done so far
+	unsigned int numStagesDone{ 0 };
+
+	// with parallel channels, the worker that takes one of the channels and the fft engine of the second channel,
+	// fft engines are not thread safe
+	std::unique_ptr<ForkJoinPool> channelWorker;
+	std::shared_ptr<AFourierTransform> secondFFT;
+};
+
+
+inline PartitionedKernel PartitionedKernel::create(const ImpulseResponse & ir, unsigned int partSize, unsigned int offset, unsigned int numPartitions)
+{
+	assert(IRTools::isPow2(partSize));
+
+	unsigned int irSize = ir.getSize();
+
+	PartitionedKernel kernel;
+	kernel.partSize = partSize;
+	kernel.fftOrder = IRTools::staticLog2(partSize) + 1;
+	kernel.numBins	= partSize + 1;
+
+	unsigned int remaining = (irSize > offset) ? irSize - offset : 0;
+	kernel.numPartitions = (numPartitions > 0) ? numPartitions : std::max((remaining + partSize - 1) / partSize, 1U);
+
+	kernel.fft = std::shared_ptr<AFourierTransform>(AFourierTransformFactory::FourierTransform(kernel.fftOrder));
+
+	kernel.binStride = (kernel.numBins + 15) & ~15U;
+	unsigned int splitSize = kernel.numPartitions * kernel.binStride;
+
+	std::vector<float> zeroPadded(2 * partSize);
+	std::vector<std::complex<float>> spectrum(kernel.numBins);
+
+	for (int c : {0, 1})
+	{
+		kernel.kernelFFTsRe[c].resize(splitSize, 0);
+		kernel.kernelFFTsIm[c].resize(splitSize, 0);
+		kernel.partitionFFTCacheRe[c].resize(splitSize, 0);
+		kernel.partitionFFTCacheIm[c].resize(splitSize, 0);
+
+		auto buffer = ir.getChannel(c);
+
+		for (unsigned int p = 0; p < kernel.numPartitions; p++)
+		{
+			unsigned int irBufferOffset = offset + p * partSize;
+			unsigned int irMaxPos = (irSize > irBufferOffset) ? std::min(irSize - irBufferOffset, partSize) : 0;
+
+			std::fill(zeroPadded.begin(), zeroPadded.end(), 0.f);
+			std::copy(buffer + irBufferOffset, buffer + irBufferOffset + irMaxPos, zeroPadded.begin());
+
+			kernel.fft->performRealFFT(zeroPadded.data(), spectrum.data());
+
+			for (unsigned int i = 0; i < kernel.numBins; i++)
+			{
+				kernel.kernelFFTsRe[c][p * kernel.binStride + i] = spectrum[i].real();
+				kernel.kernelFFTsIm[c][p * kernel.binStride + i] = spectrum[i].imag();
+			}
+		}
+	}
+
+	for (int c : {0, 1})
+	{
+		kernel.accumulatorRe[c].resize(kernel.binStride, 0);
+		kernel.accumulatorIm[c].resize(kernel.binStride, 0);
+	}
+
+	return kernel;
+}
+
+inline void PartitionedKernel::setInputFFT(unsigned int channel, const std::complex<float> * spectrum)
+{
+	auto cacheRe = &partitionFFTCacheRe[channel][currentPartition * binStride];
+	auto cacheIm = &partitionFFTCacheIm[channel][currentPartition * binStride];
+
+	for (unsigned int i = 0; i < numBins; i++)
+	{
+		cacheRe[i] = spectrum[i].real();
+		cacheIm[i] = spectrum[i].imag();
+	}
+}
+
+inline void PartitionedKernel::accumulateSpectrum(unsigned int channel, std::complex<float>* out)
+{
+	accumulateSpectrum(channel, out, 0, binStride);
+}
+
+inline void PartitionedKernel::accumulateSpectrum(unsigned int channel, std::complex<float>* out, unsigned int firstBin, unsigned int endBin)
+{
+	assert(firstBin % 16 == 0 && endBin <= binStride);
+
+	if (firstBin >= endBin) return;
+
+	auto numRangeBins = endBin - firstBin;
+
+	auto cacheRe  = partitionFFTCacheRe[channel].data() + firstBin;
+	auto cacheIm  = partitionFFTCacheIm[channel].data() + firstBin;
+	auto kernelRe = kernelFFTsRe[channel].data() + firstBin;
+	auto kernelIm = kernelFFTsIm[channel].data() + firstBin;
+	auto accRe	  = accumulatorRe[channel].data() + firstBin;
+	auto accIm	  = accumulatorIm[channel].data() + firstBin;
+
+	auto & kernels = DSPKernels::get();
+
+	std::fill(accRe, accRe + numRangeBins, 0.f);
+	std::fill(accIm, accIm + numRangeBins, 0.f);
+
+	// partition p is multiplied with the input p blocks ago, we walk the delay line backwards and wrap around once
+	unsigned int cachePartition = currentPartition;
+	for (unsigned int p = 0; p < numPartitions; p++)
+	{
+		auto kernelOffset = binStride * p;
+		auto cacheOffset  = binStride * cachePartition;
+
+		kernels.complexMultiplyAccumulate(cacheRe + cacheOffset, cacheIm + cacheOffset, kernelRe + kernelOffset, kernelIm + kernelOffset,
+			accRe, accIm, numRangeBins);
+
+		cachePartition = (cachePartition == 0) ? numPartitions - 1 : cachePartition - 1;
+	}
+
+	for (unsigned int i = firstBin; i < std::min(endBin, numBins); i++)
+	{
+		out[i] = std::complex<float>(accumulatorRe[channel][i], accumulatorIm[channel][i]);
+	}
+}
+
+inline void PartitionedKernel::advance()
+{
+	currentPartition = (currentPartition + 1 == numPartitions) ? 0 : currentPartition + 1;
+}
+
+inline UniformPartitionedKernel UniformPartitionedKernel::create(const ImpulseResponse & ir, unsigned int partSize, unsigned int numPartitions, bool balanced)
+{
+	UniformPartitionedKernel kernel;
+	static_cast<PartitionedKernel&>(kernel) = PartitionedKernel::create(ir, partSize, 0, numPartitions);
+
+	kernel.balanced = balanced;
+
+	for (int c : {0, 1})
+	{
+		kernel.outputAccumulator[c].resize(2 * partSize, 0);
+		kernel.audioInput[c].resize(2 * partSize, 0);
+		kernel.outputFFT[c].resize(kernel.numBins, 0);
+
+		if (balanced) kernel.pendingBlock[c].resize(2 * partSize, 0);
+	}
+
+	return kernel;
+}
+
+inline void UniformPartitionedKernel::getMACStageRange(unsigned int stage, unsigned int & firstBin, unsigned int & endBin) const
+{
+	// ranges are multiples of 16 bins to keep the spectra aligned
+	unsigned int rangeSize = ((binStride / 16 + NumMACStages - 1) / NumMACStages) * 16;
+
+	firstBin = std::min(stage * rangeSize, binStride);
+	endBin	 = std::min(firstBin + rangeSize, binStride);
+}
+
+inline void UniformPartitionedKernel::createChannelWorker(double periodSeconds)
+{
+	if (std::thread::hardware_concurrency() < 2) return;
+
+	secondFFT = std::shared_ptr<AFourierTransform>(AFourierTransformFactory::FourierTransform(fftOrder));
+	channelWorker = std::unique_ptr<ForkJoinPool>(new ForkJoinPool(1, periodSeconds));
+}
+
+template<typename Function>
+inline void UniformPartitionedKernel::forEachChannel(Function && function)
+{
+	if (channelWorker)
+	{
+		channelWorker->run(2, function);
+	}
+	else
+	{
+		function(0);
+		function(1);
+	}
+}
+
+inline void UniformPartitionedKernel::transformInput(unsigned int channel)
+{
+	auto & channelFFT = (channel == 1 && secondFFT) ? secondFFT : fft;
+	auto input = audioInput[channel].data();
+
+	// zero pad input
+	std::fill(input + partSize, input + 2 * partSize, 0.f);
+
+	// to frequency domain
+	channelFFT->performRealFFT(input, outputFFT[channel].data());
+	setInputFFT(channel, outputFFT[channel].data());
+}
+
+inline void UniformPartitionedKernel::transformOutput(unsigned int channel)
+{
+	auto & channelFFT = (channel == 1 && secondFFT) ? secondFFT : fft;
+	auto result = audioInput[channel].data();
+
+	// back to time domain, the input buffer is reused for the result
+	channelFFT->performRealIFFT(outputFFT[channel].data(), result);
+
+	// overlap add: the first half plus the last tail is the next output block, the second half is the new tail
+	auto output = outputAccumulator[channel].data();
+
+	for (unsigned int i = 0; i < partSize; i++)
+	{
+		output[i] = result[i] + output[i + partSize];
+		output[i + partSize] = result[i + partSize];
+	}
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#if defined(__APPLE__)
+#include <mach/mach.h>
+#include <mach/mach_time.h>
+#include <mach/thread_policy.h>
+#elif defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+
+/**
+	Helpers for worker threads that have to keep up with the audio thread.
+*/
+namespace RealtimeThread
+{
+	/**
+		Gives the calling thread real time priority, so it isn't delayed by ordinary threads. Uses SCHED_FIFO in the middle of the
+		priority range on POSIX systems, a time constraint policy on macOS and time critical priority on Windows.
+		Fails without permission, e.g. on Linux without an rtprio limit, the thread then keeps its priority.
+		@param periodSeconds the period the thread has to deliver results in, used by the macOS time constraint policy
+		@return true if the priority was raised
+	*/
+	inline bool setPriority(double periodSeconds)
+	{
+#if defined(__APPLE__)
+		mach_timebase_info_data_t timebase;
+		mach_timebase_info(&timebase);
+
+		double ticksPerSecond = 1e9 * timebase.denom / timebase.numer;
+
+		// the thread may use half of the period and has to be done within it
+		thread_time_constraint_policy_data_t policy;
+		policy.period	   = static_cast<uint32_t>(periodSeconds * ticksPerSecond);
+		policy.computation = static_cast<uint32_t>(0.5 * periodSeconds * ticksPerSecond);
+		policy.constraint  = static_cast<uint32_t>(periodSeconds * ticksPerSecond);
+		policy.preemptible = 1;
+
+		return thread_policy_set(mach_thread_self(), THREAD_TIME_CONSTRAINT_POLICY, reinterpret_cast<thread_policy_t>(&policy),
+			THREAD_TIME_CONSTRAINT_POLICY_COUNT) == KERN_SUCCESS;
+#elif defined(_WIN32)
+		(void)periodSeconds;
+		return SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL) != 0;
+#else
+		(void)periodSeconds;
+
+		// audio threads usually run higher, the worker shouldn't preempt them
+		int minPriority = sched_get_priority_min(SCHED_FIFO);
+		int maxPriority = sched_get_priority_max(SCHED_FIFO);
+
+		sched_param parameters;
+		parameters.sched_priority = minPriority + (maxPriority - minPriority) / 2;
+
+		return pthread_setschedparam(pthread_self(), SCHED_FIFO, &parameters) == 0;
+#endif
+	}
+}
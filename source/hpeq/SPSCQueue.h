@@ -0,0 +1,209 @@
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <cassert>
+
+/**
+	A bounded, lock free single producer single consumer queue that moves samples block wise, e.g. to carry audio blocks
+	between the audio thread and a worker thread. Neither #push nor #pull lock or allocate.
+
+	The capacity is a power of 2 and set at runtime with #setSize, the queue never reallocates while in use. The read and write
+	indices are free running counters published with acquire / release semantics. Each side caches the index of the other side
+	and only reloads it when the cached value doesn't suffice, so the cache line of the other side is rarely touched.
+
+	Exactly one thread may push and exactly one thread may pull at a time.
+	@param T the queued sample type, should be trivially copyable
+*/
+template<typename T>
+class SPSCQueue
+{
+public:
+	/**
+		Creates the queue.
+		@param size the capacity of the queue, has to be a power of 2
+	*/
+	SPSCQueue(unsigned int size = 0);
+	~SPSCQueue() = default;
+
+	SPSCQueue(const SPSCQueue &) = delete;
+	SPSCQueue & operator=(const SPSCQueue &) = delete;
+
+public:
+
+	/**
+		Returns the capacity of the queue.
+	*/
+	unsigned int getSize() const;
+
+	/**
+		Changes the capacity and clears the queue. Allocates memory, must not be called while the queue is in use.
+		@param size the capacity of the queue, has to be a power of 2
+	*/
+	void setSize(unsigned int size);
+
+	/**
+		Writes up to @p numSamples samples to the queue head. Producer thread only.
+		@param input the samples to be pushed
+		@param numSamples the number of samples to be pushed
+		@return the number of samples actually pushed, less than @p numSamples if the queue is full
+	*/
+	unsigned int push(const T * input, unsigned int numSamples);
+
+	/**
+		Reads up to @p numSamples samples from the queue tail. Consumer thread only.
+		@param output the buffer the samples are written to
+		@param numSamples the number of samples to be pulled
+		@return the number of samples actually pulled, less than @p numSamples if the queue runs empty
+	*/
+	unsigned int pull(T * output, unsigned int numSamples);
+
+	/**
+		Returns the number of samples that can be pulled. Exact on the consumer thread, a lower bound on the producer thread.
+	*/
+	unsigned int getNumReady() const;
+
+	/**
+		Returns the number of samples that can be pushed. Exact on the producer thread, a lower bound on the consumer thread.
+	*/
+	unsigned int getNumFree() const;
+
+	/**
+		Clears the queue. Must not be called while the queue is in use.
+	*/
+	void clear();
+
+private:
+
+	/**
+		Copies @p numSamples samples from @p source starting at ring position @p index, wraps around once.
+	*/
+	void copyToBuffer(unsigned int index, const T * source, unsigned int numSamples);
+
+	/**
+		Copies @p numSamples samples to @p destination starting at ring position @p index, wraps around once.
+	*/
+	void copyFromBuffer(unsigned int index, T * destination, unsigned int numSamples) const;
+
+private:
+	unsigned int size{ 0 };
+	unsigned int mask{ 0 };
+
+	std::vector<T> buffer;
+
+	// the producer and consumer state are kept on separate cache lines so the two threads don't invalidate each other
+	char paddingProducer[64];
+
+	// written by the producer, the indices are free running and only masked on access
+	std::atomic<unsigned int> writeIndex{ 0 };
+	unsigned int cachedReadIndex{ 0 };
+
+	char paddingConsumer[64];
+
+	// written by the consumer
+	std::atomic<unsigned int> readIndex{ 0 };
+	unsigned int cachedWriteIndex{ 0 };
+};
+
+template<typename T>
+inline SPSCQueue<T>::SPSCQueue(unsigned int size)
+{
+	setSize(size);
+}
+
+template<typename T>
+inline unsigned int SPSCQueue<T>::getSize() const
+{
+	return size;
+}
+
+template<typename T>
+inline void SPSCQueue<T>::setSize(unsigned int size)
+{
+	assert((size & (size - 1)) == 0);
+
+	this->size = size;
+	this->mask = (size > 0) ? size - 1 : 0;
+	buffer.assign(size, T(0));
+
+	clear();
+}
+
+template<typename T>
+inline unsigned int SPSCQueue<T>::push(const T * input, unsigned int numSamples)
+{
+	auto write = writeIndex.load(std::memory_order_relaxed);
+
+	// the consumer only frees space, so a stale read index is on the safe side
+	if (size - (write - cachedReadIndex) < numSamples)
+	{
+		cachedReadIndex = readIndex.load(std::memory_order_acquire);
+	}
+
+	numSamples = std::min(numSamples, size - (write - cachedReadIndex));
+	if (numSamples == 0) return 0;
+
+	copyToBuffer(write & mask, input, numSamples);
+
+	writeIndex.store(write + numSamples, std::memory_order_release);
+	return numSamples;
+}
+
+template<typename T>
+inline unsigned int SPSCQueue<T>::pull(T * output, unsigned int numSamples)
+{
+	auto read = readIndex.load(std::memory_order_relaxed);
+
+	// the producer only adds samples, so a stale write index is on the safe side
+	if (cachedWriteIndex - read < numSamples)
+	{
+		cachedWriteIndex = writeIndex.load(std::memory_order_acquire);
+	}
+
+	numSamples = std::min(numSamples, cachedWriteIndex - read);
+	if (numSamples == 0) return 0;
+
+	copyFromBuffer(read & mask, output, numSamples);
+
+	readIndex.store(read + numSamples, std::memory_order_release);
+	return numSamples;
+}
+
+template<typename T>
+inline unsigned int SPSCQueue<T>::getNumReady() const
+{
+	return writeIndex.load(std::memory_order_acquire) - readIndex.load(std::memory_order_acquire);
+}
+
+template<typename T>
+inline unsigned int SPSCQueue<T>::getNumFree() const
+{
+	return size - getNumReady();
+}
+
+template<typename T>
+inline void SPSCQueue<T>::clear()
+{
+	writeIndex.store(0, std::memory_order_relaxed);
+	readIndex.store(0, std::memory_order_relaxed);
+	cachedReadIndex = cachedWriteIndex = 0;
+}
+
+template<typename T>
+inline void SPSCQueue<T>::copyToBuffer(unsigned int index, const T * source, unsigned int numSamples)
+{
+	unsigned int numFirst = std::min(numSamples, size - index);
+
+	std::copy(source, source + numFirst, buffer.begin() + index);
+	std::copy(source + numFirst, source + numSamples, buffer.begin());
+}
+
+template<typename T>
+inline void SPSCQueue<T>::copyFromBuffer(unsigned int index, T * destination, unsigned int numSamples) const
+{
+	unsigned int numFirst = std::min(numSamples, size - index);
+
+	std::copy(buffer.begin() + index, buffer.begin() + index + numFirst, destination);
+	std::copy(buffer.begin(), buffer.begin() + (numSamples - numFirst), destination + numFirst);
+}
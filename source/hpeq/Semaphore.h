@@ -0,0 +1,172 @@
+#pragma once
+
+#include <atomic>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif defined(__APPLE__)
+#include <dispatch/dispatch.h>
+#elif defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <mutex>
+#include <condition_variable>
+#endif
+
+
+/**
+	A counting semaphore to wake worker threads from the audio thread.
+
+	#post never locks or allocates. It maps to a futex on Linux, a dispatch semaphore on macOS and a semaphore object on
+	Windows, on other platforms it falls back to a condition variable whose mutex is only held for the increment.
+	The waiting side may block, it is meant for worker threads only.
+*/
+class Semaphore
+{
+public:
+	Semaphore();
+	~Semaphore();
+
+	Semaphore(const Semaphore &) = delete;
+	Semaphore & operator=(const Semaphore &) = delete;
+
+	/**
+		Increments the count and wakes a waiting thread. Can be called from the audio thread.
+	*/
+	inline void post();
+
+	/**
+		Blocks until the count is positive and decrements it.
+	*/
+	inline void wait();
+
+private:
+#if defined(__linux__)
+	std::atomic<int> count{ 0 };
+	std::atomic<int> numWaiters{ 0 };
+#elif defined(__APPLE__)
+	dispatch_semaphore_t semaphore;
+#elif defined(_WIN32)
+	HANDLE semaphore;
+#else
+	int count{ 0 };
+	std::mutex mutex;
+	std::condition_variable condition;
+#endif
+};
+
+
+#if defined(__linux__)
+
+inline Semaphore::Semaphore()
+{
+	static_assert(sizeof(std::atomic<int>) == sizeof(int), "the futex works on the int of the atomic");
+}
+
+inline Semaphore::~Semaphore()
+{
+}
+
+inline void Semaphore::post()
+{
+	count.fetch_add(1);
+
+	// the waiter registers before it sleeps and the kernel checks the count again, so no wake up is lost
+	if (numWaiters.load() > 0)
+	{
+		syscall(SYS_futex, reinterpret_cast<int*>(&count), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+	}
+}
+
+inline void Semaphore::wait()
+{
+	while (true)
+	{
+		int current = count.load();
+		while (current > 0)
+		{
+			if (count.compare_exchange_weak(current, current - 1)) return;
+		}
+
+		numWaiters.fetch_add(1);
+		syscall(SYS_futex, reinterpret_cast<int*>(&count), FUTEX_WAIT_PRIVATE, 0, nullptr, nullptr, 0);
+		numWaiters.fetch_sub(1);
+	}
+}
+
+#elif defined(__APPLE__)
+
+inline Semaphore::Semaphore()
+	: semaphore(dispatch_semaphore_create(0))
+{
+}
+
+inline Semaphore::~Semaphore()
+{
+	dispatch_release(semaphore);
+}
+
+inline void Semaphore::post()
+{
+	dispatch_semaphore_signal(semaphore);
+}
+
+inline void Semaphore::wait()
+{
+	dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER);
+}
+
+#elif defined(_WIN32)
+
+inline Semaphore::Semaphore()
+	: semaphore(CreateSemaphore(nullptr, 0, LONG_MAX, nullptr))
+{
+}
+
+inline Semaphore::~Semaphore()
+{
+	CloseHandle(semaphore);
+}
+
+inline void Semaphore::post()
+{
+	ReleaseSemaphore(semaphore, 1, nullptr);
+}
+
+inline void Semaphore::wait()
+{
+	WaitForSingleObject(semaphore, INFINITE);
+}
+
+#else
+
+inline Semaphore::Semaphore()
+{
+}
+
+inline Semaphore::~Semaphore()
+{
+}
+
+inline void Semaphore::post()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		count++;
+	}
+	condition.notify_one();
+}
+
+inline void Semaphore::wait()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	condition.wait(lock, [this]() { return count > 0; });
+	count--;
+}
+
+#endif
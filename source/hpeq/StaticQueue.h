@@ -1,32 +1,30 @@
 #pragma once
 
-#include <array>
+#include <vector>
 #include <cassert>
 #include <cmath>
 
-constexpr bool isPowerOfTwo(int x)
-{
-	return x && ((x & (x - 1)) == 0);
-}
-
 /**
-	A queue buffer of variable type with a static max size.
+	A queue buffer of variable type with a fixed size. The size is set at runtime but the queue never reallocates while in use.
 	@param T the queued sample type
-	@param MaxSize the static buffer size of the queue
 */
-template<typename T, unsigned int MaxSize>
+template<typename T>
 class StaticQueue
 {
 public:
-	StaticQueue(unsigned int length = 0);
+	/**
+		Creates the queue.
+		@param size the buffer size of the queue, has to be a power of 2
+	*/
+	StaticQueue(unsigned int size = 0);
 	~StaticQueue() = default;
 
 	StaticQueue(const  StaticQueue &) = default;
 	StaticQueue(StaticQueue &&) = default;
-	
+
 	StaticQueue & operator=(const  StaticQueue &) = default;
 	StaticQueue & operator=(StaticQueue &&) = default;
-	
+
 
 public:
 
@@ -34,7 +32,13 @@ public:
 		Returns the maximum queue length.
 	*/
 	unsigned int getSize() const;
-	
+
+	/**
+		Changes the buffer size and clears the queue. Allocates memory, should not be called from the audio thread.
+		@param size the buffer size of the queue, has to be a power of 2
+	*/
+	void setSize(unsigned int size);
+
 	/**
 		Writes a sample to the queue head
 		@param input the sample to be pushed
@@ -65,39 +69,50 @@ public:
 	unsigned int getLength() const;
 
 private:
-	static const unsigned int Mask{ MaxSize - 1 };
+	unsigned int mask{ 0 };
 
-	std::array<T, MaxSize> buffer;
+	std::vector<T> buffer;
 	unsigned int writePos{ 0 };
 	unsigned int readPos{ 0 };
 	unsigned int len{ 0 };
 
-	
+
 };
 
-template<typename T, unsigned int MaxSize>
-inline StaticQueue<T, MaxSize>::StaticQueue(unsigned int length)
+template<typename T>
+inline StaticQueue<T>::StaticQueue(unsigned int size)
+{
+	setSize(size);
+}
+
+template<typename T>
+inline unsigned int StaticQueue<T>::getSize() const
 {
-	static_assert(isPowerOfTwo(MaxSize), "MaxSize should be a power of two");
-	buffer.fill(T(0));
+	return buffer.size();
 }
 
-template<typename T, unsigned int MaxSize>
-inline unsigned int StaticQueue<T, MaxSize>::getSize() const
+template<typename T>
+inline void StaticQueue<T>::setSize(unsigned int size)
 {
-	return MaxSize;
+	assert((size & (size - 1)) == 0);
+
+	buffer.assign(size, T(0));
+	mask = (size > 0) ? size - 1 : 0;
+
+	len = 0;
+	writePos = readPos = 0;
 }
 
-template<typename T, unsigned int MaxSize>
-inline void StaticQueue<T, MaxSize>::push(const T & input)
+template<typename T>
+inline void StaticQueue<T>::push(const T & input)
 {
 	len++;
 	buffer[writePos] = input;
-	writePos = (writePos + 1) & Mask;
+	writePos = (writePos + 1) & mask;
 }
 
-template<typename T, unsigned int MaxSize>
-inline void StaticQueue<T, MaxSize>::push(const T & input, unsigned int N)
+template<typename T>
+inline void StaticQueue<T>::push(const T & input, unsigned int N)
 {
 	for (int i = 0; i < N; i++)
 	{
@@ -105,25 +120,25 @@ inline void StaticQueue<T, MaxSize>::push(const T & input, unsigned int N)
 	}
 }
 
-template<typename T, unsigned int MaxSize>
-inline T StaticQueue<T, MaxSize>::pull()
+template<typename T>
+inline T StaticQueue<T>::pull()
 {
 	len--;
 	auto out = 	buffer[readPos];
-	readPos = (readPos + 1) & Mask;
+	readPos = (readPos + 1) & mask;
 	return out;
 }
 
-template<typename T, unsigned int MaxSize>
-inline void StaticQueue<T, MaxSize>::clear()
+template<typename T>
+inline void StaticQueue<T>::clear()
 {
 	len = 0;
 	writePos = readPos = 0;
-	buffer[writePos] = 0;
+	if (!buffer.empty()) buffer[writePos] = 0;
 }
 
-template<typename T, unsigned int MaxSize>
-inline unsigned int StaticQueue<T, MaxSize>::getLength() const
+template<typename T>
+inline unsigned int StaticQueue<T>::getLength() const
 {
 	return len;
 }
@@ -1,21 +1,15 @@
 #pragma once
 
-#include <array>
+#include <vector>
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 
-namespace
-{
-	constexpr bool isPowerOfTwo(int x)
-	{
-		return x && ((x & (x - 1)) == 0);
-	}
-}
-
 /**
-	A ring buffer of variable type with a static max size.
+	A ring buffer of variable type with a power of 2 size. The size is set at runtime, but only #setSize and #setLengthAndResize
+	allocate, so the buffer can be used in time critical code once it was configured.
 */
-template<typename T, unsigned int MaxSize>
+template<typename T>
 class StaticRingBuffer
 {
 public:
@@ -47,23 +41,23 @@ public:
 	void setLength(unsigned int length);
 
 	/**
-		Function changes the length and updates the size to the closest sufficiently large power of two
+		Function changes the length and updates the size to the closest sufficiently large power of two.
+		Allocates memory if the size changes.
 	*/
 	void setLengthAndResize(unsigned int length);
 
 	/**
-		Functions updates the internally used memory range for perfomrance. 
-		Fills the std::array with a specific value
+		Functions changes the buffer size and fills the buffer with a specific value. Allocates memory.
 	*/
 	void setSize(unsigned int size, const T & fillVal);
 
 	/**
-		Functions updates the internally used memory range for perfomrance
+		Functions changes the buffer size. Allocates memory.
 	*/
 	void setSize(unsigned int size);
 
 	/**
-		Functions fills the internal std::array with a given value @p val
+		Functions fills the internal buffer with a given value @p val
 	*/
 	void fill(const T & val = T(0));
 
@@ -96,44 +90,42 @@ public:
 private:
 
 	unsigned int length{ 0 };
-	unsigned int size{ MaxSize };
-	unsigned int mask{ MaxSize - 1 };
+	unsigned int size{ 0 };
+	unsigned int mask{ 0 };
 
-	std::array<T, MaxSize> buffer;
+	std::vector<T> buffer;
 	int writePos{ 0 };
 
 	
 };
 
-template<typename T, unsigned int MaxSize>
-inline StaticRingBuffer<T, MaxSize>::StaticRingBuffer(unsigned int length)
+template<typename T>
+inline StaticRingBuffer<T>::StaticRingBuffer(unsigned int length)
 {
-	static_assert(isPowerOfTwo(MaxSize), "MaxSize should be a power of two");
-	buffer.fill(T(0));
-	setLength(length);
+	setLengthAndResize(length);
 }
 
-template<typename T, unsigned int MaxSize>
-inline unsigned int StaticRingBuffer<T, MaxSize>::getLength() const
+template<typename T>
+inline unsigned int StaticRingBuffer<T>::getLength() const
 {
 	return length;
 }
 
-template<typename T, unsigned int MaxSize>
-inline unsigned int StaticRingBuffer<T, MaxSize>::getSize() const
+template<typename T>
+inline unsigned int StaticRingBuffer<T>::getSize() const
 {
 	return size;
 }
 
-template<typename T, unsigned int MaxSize>
-inline void StaticRingBuffer<T, MaxSize>::setLength(unsigned int length)
+template<typename T>
+inline void StaticRingBuffer<T>::setLength(unsigned int length)
 {
 	assert(length < size);
 	this->length = length;
 }
 
-template<typename T, unsigned int MaxSize>
-inline void StaticRingBuffer<T, MaxSize>::setLengthAndResize(unsigned int length)
+template<typename T>
+inline void StaticRingBuffer<T>::setLengthAndResize(unsigned int length)
 {
 	this->length = length;
 	unsigned int closestPow2Fit = std::pow(2, std::ceil(std::log2(length+1)));
@@ -144,16 +136,16 @@ inline void StaticRingBuffer<T, MaxSize>::setLengthAndResize(unsigned int length
 	}
 }
 
-template<typename T, unsigned int MaxSize>
-inline void StaticRingBuffer<T, MaxSize>::fill(const T & val)
+template<typename T>
+inline void StaticRingBuffer<T>::fill(const T & val)
 {
-	buffer.fill(val);
+	std::fill(buffer.begin(), buffer.end(), val);
 }
 
-template<typename T, unsigned int MaxSize>
-inline T StaticRingBuffer<T, MaxSize>::tick(const T & input)
+template<typename T>
+inline T StaticRingBuffer<T>::tick(const T & input)
 {
-	unsigned int readPos  = (static_cast<int>(writePos)-static_cast<int>(length)+ static_cast<int>(MaxSize)) & mask;
+	unsigned int readPos  = static_cast<unsigned int>(writePos - static_cast<int>(length)) & mask;
 
 	auto output = buffer[readPos];
 
@@ -164,46 +156,48 @@ inline T StaticRingBuffer<T, MaxSize>::tick(const T & input)
 	return output;
 }
 
-template<typename T, unsigned int MaxSize>
-inline void StaticRingBuffer<T, MaxSize>::setSize(unsigned int size, const T & fillVal)
+template<typename T>
+inline void StaticRingBuffer<T>::setSize(unsigned int size, const T & fillVal)
 {
 	setSize(size);
 	fill(fillVal);
 }
 
-template<typename T, unsigned int MaxSize>
-inline void StaticRingBuffer<T, MaxSize>::setSize(unsigned int size)
+template<typename T>
+inline void StaticRingBuffer<T>::setSize(unsigned int size)
 {
-	assert(size <= MaxSize);
-	assert(isPowerOfTwo(size));
+	assert(size > 0);
+	assert((size & (size - 1)) == 0);
 	this->size = size;
 	this->mask = size - 1;
 
+	buffer.resize(size, T(0));
+
 	writePos = (writePos) & mask;
 }
 
-template<typename T, unsigned int MaxSize>
-inline void StaticRingBuffer<T, MaxSize>::increment()
+template<typename T>
+inline void StaticRingBuffer<T>::increment()
 {
 	writePos = (writePos + 1) & mask;
 }
 
-template<typename T, unsigned int MaxSize>
-inline T & StaticRingBuffer<T, MaxSize>::operator[](int idx)
+template<typename T>
+inline T & StaticRingBuffer<T>::operator[](int idx)
 {
-	unsigned int pos = (static_cast<int>(writePos) - idx + static_cast<int>(MaxSize)) & mask;
+	unsigned int pos = static_cast<unsigned int>(writePos - idx) & mask;
 
 	return buffer[pos];
 }
 
 
-template<typename T, unsigned int MaxSize>
-inline T StaticRingBuffer<T, MaxSize>::readF(float pos)
+template<typename T>
+inline T StaticRingBuffer<T>::readF(float pos)
 {
 	unsigned int posInt = pos;
 	float frac = pos - static_cast<float>(posInt);
-	unsigned int pos1 = (writePos - posInt     + MaxSize) & mask;
-	unsigned int pos2 = (writePos - (posInt+1) + MaxSize) & mask;
+	unsigned int pos1 = (writePos - posInt    ) & mask;
+	unsigned int pos2 = (writePos - (posInt+1)) & mask;
 
 	auto y1 = buffer[pos1];
 	auto y2 = buffer[pos2];
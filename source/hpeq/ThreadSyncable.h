@@ -1,65 +1,161 @@
 #pragma once
 
+#include <atomic>
+#include <memory>
 #include <mutex>
 
 
 /**
-	A small utility class that helps to sync bigger data via main and audio thread with a combination of
-	locks and pointer swap.
+	A small utility class that helps to sync bigger data via main and audio thread with atomic pointer exchanges.
+
+	The data is passed through three slots:
+	- pending: set by #set, taken by #update
+	- live: only accessed by the time sensitive thread
+	- retired: the former live data, handed back by #update and deleted by the next #set or #releaseRetired
+
+	The time sensitive thread never locks, allocates or frees memory. If the retired slot wasn't cleared yet,
+	#update keeps the current data and picks up the pending data with a later call.
+
+	An #update racing with #set can fill the retired slot right after #set cleared it. The source thread has to
+	call #releaseRetired regularly, otherwise the pending data is held back until the next #set.
 */
 template <typename T>
 class ThreadSyncable
 {
 public:
+	/**
+		Creates the syncable with default constructed live data.
+	*/
+	ThreadSyncable();
+
+	/**
+		Creates the syncable with the given live data.
+		@param initialData the initial live data, might be nullptr
+	*/
+	explicit ThreadSyncable(std::unique_ptr<T> initialData);
+
+	~ThreadSyncable();
+
 	/**
 		Sets the content from the source thread (main / 3rd thread). Should not be called from a time sensitive thread.
+		Allocates the new data and frees data retired by #update.
 		@param data the data to be set.
 	*/
 	void set(const T& data);
 
-	
+	/**
+		Sets the content from the source thread (main / 3rd thread) by moving it. Should not be called from a time sensitive thread.
+		Frees data retired by #update.
+		@param data the data to be set.
+	*/
+	void set(T&& data);
 
 	/**
-		Polls for an update and if necessary swaps the live thread data with the offline data. 
-		Should be called from the time sensitive thread. Function locks a mutex shared with #set but generally has a low CPU footprint. (No allocation)
+		Hands over the content from the source thread (main / 3rd thread). Should not be called from a time sensitive thread.
+		Frees data retired by #update.
+		@param data the data to be set.
+	*/
+	void set(std::unique_ptr<T> data);
+
+	/**
+		Frees data retired by #update. Should not be called from a time sensitive thread.
+	*/
+	void releaseRetired();
+
+	/**
+		Polls for an update and if necessary swaps the live thread data with the pending data.
+		Should be called from the time sensitive thread. Wait free, no locks, no allocation.
 		@return true if the data was updated.
-		*/
+	*/
 	bool update();
 
 	/**
-		Returns a raw access to the live data. Might return nullptr. 
+		Returns a raw access to the live data. Might return nullptr.
 	*/
 	T * get();
 
 private:
-	std::mutex syncMutex;
-	bool updated{ false };
+	// serializes source threads, never locked by the time sensitive thread
+	std::mutex setMutex;
 
-	std::unique_ptr<T> offlineData{ std::unique_ptr<T>(new T()) };
-	std::unique_ptr<T> liveData{ std::unique_ptr<T>(new T()) };
+	std::atomic<T*> pendingData{ nullptr };
+	std::atomic<T*> retiredData{ nullptr };
+
+	std::unique_ptr<T> liveData;
 };
 
+template<typename T>
+inline ThreadSyncable<T>::ThreadSyncable()
+	: ThreadSyncable(std::unique_ptr<T>(new T()))
+{
+}
+
+template<typename T>
+inline ThreadSyncable<T>::ThreadSyncable(std::unique_ptr<T> initialData)
+	: liveData(std::move(initialData))
+{
+}
+
+template<typename T>
+inline ThreadSyncable<T>::~ThreadSyncable()
+{
+	delete pendingData.exchange(nullptr);
+	delete retiredData.exchange(nullptr);
+}
+
 template<typename T>
 inline void ThreadSyncable<T>::set(const T & data)
 {
-	std::lock_guard<std::mutex> lock(syncMutex);
+	set(std::unique_ptr<T>(new T(data)));
+}
+
+template<typename T>
+inline void ThreadSyncable<T>::set(T && data)
+{
+	set(std::unique_ptr<T>(new T(std::move(data))));
+}
+
+template<typename T>
+inline void ThreadSyncable<T>::set(std::unique_ptr<T> data)
+{
+	std::lock_guard<std::mutex> lock(setMutex);
 
-	offlineData = std::unique_ptr<T>(new T(data));
-	updated = true;
+	// publish, pending data that was never picked up can be deleted right away
+	delete pendingData.exchange(data.release(), std::memory_order_acq_rel);
+
+	// free the data the audio thread handed back. Done after publishing, so that a retired slot filled
+	// in between can't hold back the new data until the next call
+	delete retiredData.exchange(nullptr, std::memory_order_acq_rel);
+}
+
+template<typename T>
+inline void ThreadSyncable<T>::releaseRetired()
+{
+	std::lock_guard<std::mutex> lock(setMutex);
+
+	delete retiredData.exchange(nullptr, std::memory_order_acq_rel);
 }
 
 template<typename T>
 inline bool ThreadSyncable<T>::update()
 {
-	std::lock_guard<std::mutex> lock(syncMutex);
+	// the old live data has to go somewhere, wait until the source thread cleared the slot
+	if (retiredData.load(std::memory_order_acquire) != nullptr)
+	{
+		return false;
+	}
 
-	if (updated)
+	T * newData = pendingData.exchange(nullptr, std::memory_order_acq_rel);
+
+	if (newData == nullptr)
 	{
-		std::swap(offlineData, liveData);
-		updated = false;
-		return true;
+		return false;
 	}
-	return false;
+
+	retiredData.store(liveData.release(), std::memory_order_release);
+	liveData.reset(newData);
+
+	return true;
 }
 
 template<typename T>
@@ -2,86 +2,130 @@
 
 
 #include "ASyncedConvolutionEngine.h"
-#include "StaticRingBuffer.h"
+#include "AlignedAllocator.h"
+#include "DSPKernels.h"
+#include <algorithm>
 
 
 /**
-	A time domain convlolution engine with a static MaxSize. MaxSize has to be a power of 2.
+	Contains the time reversed impulse response used by #TimeDomainConvolution together with the input history sized to fit it.
+	Created by the pre processor so that the audio thread doesn't need to allocate.
 */
-template<unsigned int MaxSize>
-class TimeDomainConvolution : public ASyncedConvolutionEngine<ImpulseResponse>
+struct TimeDomainKernel
 {
-public:
-	virtual void process(const float * readL, const float * readR, float * writeL, float * writeR, unsigned int numSamples) override;
-	
-protected:
-	// Inherited via ASyncedConvolutionEngine
-	virtual ImpulseResponse preProcess(const ImpulseResponse & ir) override;
+	// the number of taps, the impulse response size zero padded to one of the fixed FIR sizes or a multiple of 16
+	unsigned int size{ 0 };
+
+	// time reversed impulse response per channel, size taps
+	AlignedVector<float> reversedIR[2];
 
-	virtual void onDataUpdate() override;
+	// linear input history per channel, the last size - 1 input samples followed by the current block
+	std::vector<float> history[2];
+};
 
-private:
+/**
+	A zero latency time domain convlolution engine, intended for short impulse responses.
 
-	// ToDo: replace left and right with vector or at least with a struct containing both l and r
-	// No need to have two seperate buffers
+	The engine implements a direct form FIR in gather form: every output sample is the dot product of the time reversed
+	impulse response and the input history, which runs on the #DSPKernels selected for the CPU. The input is collected block wise in a
+	linear history buffer, so the dot products read contiguous memory and the history is only moved once per block.
 
-	StaticRingBuffer<float, MaxSize> bufferL;
-	StaticRingBuffer<float, MaxSize> bufferR;
-	
+	Impulse responses up to 256 taps that are at most #MaxFixedFIRPadding taps short of one of the #DSPKernels::FixedFIRSizes are padded
+	to it and use the FIR kernel specialized for it. Longer padding costs more than the specialized kernel saves, e.g. 129 taps run
+	faster as 144 taps on the generic kernel than as 256 taps on the specialized one.
+*/
+class TimeDomainConvolution : public ASyncedConvolutionEngine<TimeDomainKernel>
+{
+public:
+	/**
+		Maximum number of samples processed per block, sets the size of the history buffer.
+	*/
+	static const unsigned int BlockSize{ 256 };
+
+	/**
+		Maximum number of taps added on top of the size rounded to 16 taps to reach a fixed FIR size.
+	*/
+	static const unsigned int MaxFixedFIRPadding{ 16 };
+
+public:
+	virtual void process(const float * readL, const float * readR, float * writeL, float * writeR, unsigned int numSamples) override;
+
+protected:
+	// Inherited via ASyncedConvolutionEngine
+	virtual TimeDomainKernel preProcess(const ImpulseResponse & ir) override;
 };
 
 
-template<unsigned int MaxSize>
-void TimeDomainConvolution<MaxSize>::process(const float * readL, const float * readR, float * writeL, float * writeR, unsigned int numSamples)
+inline void TimeDomainConvolution::process(const float * readL, const float * readR, float * writeL, float * writeR, unsigned int numSamples)
 {
-	// cache some variables for readability 
 	updateData();
 
-	auto ir = getData();
-	auto irSize = std::min(ir->getSize(), bufferL.getLength()); // double check size to prevent access violation 
-	auto irBufferL = ir->getLeft();
-	auto irBufferR = ir->getRight();
+	auto kernel = getData();
+	auto size = kernel->size;
 
-
-	for (int i = 0; i < numSamples; i++)
+	if (size == 0)
 	{
-		float l = readL[i];
-		float r = readR[i];
+		std::fill(writeL, writeL + numSamples, 0.f);
+		std::fill(writeR, writeR + numSamples, 0.f);
+		return;
+	}
 
-		// current sample
-		writeL[i] =  bufferL[0] += l * irBufferL[0];
-		writeR[i] =  bufferR[0] += r * irBufferR[0];
+	auto firFilter = DSPKernels::get().getFIRFilter(size);
 
-		// add the IR multiplied by input sample in the ringbuffer to future samples
-		for (int k = 1; k < irSize; k++)
+	const float * read[2]  = { readL, readR };
+	float		* write[2] = { writeL, writeR };
+
+	unsigned int i = 0;
+	while (i < numSamples)
+	{
+		unsigned int numRunSamples = std::min(numSamples - i, static_cast<unsigned int>(BlockSize));
+
+		for (int c : {0, 1})
 		{
-			// writing to the futre, yea!
-			bufferL[-k] += l * irBufferL[k];
-			bufferR[-k] += r * irBufferR[k];
+			auto history = kernel->history[c].data();
+
+			// append the block to the history first, input and output buffers might be the same
+			std::copy(read[c] + i, read[c] + i + numRunSamples, history + size - 1);
+
+			firFilter(history, kernel->reversedIR[c].data(), size, write[c] + i, numRunSamples);
+
+			// keep the last size - 1 samples for the next block
+			std::copy(history + numRunSamples, history + numRunSamples + size - 1, history);
 		}
-		
-		// flush current sample and increment
-		bufferL[0] = bufferR[0] = 0;
-		bufferR.increment();
-		bufferL.increment();
+
+		i += numRunSamples;
 	}
 }
 
-template<unsigned int MaxSize>
-inline ImpulseResponse TimeDomainConvolution<MaxSize>::preProcess(const ImpulseResponse & ir)
+inline TimeDomainKernel TimeDomainConvolution::preProcess(const ImpulseResponse & ir)
 {
-	return ir;
-}
+	TimeDomainKernel kernel;
 
-template<unsigned int MaxSize>
-void TimeDomainConvolution<MaxSize>::onDataUpdate()
-{
-	auto ir = getData();
+	unsigned int irSize = ir.getSize();
+	if (irSize == 0) return kernel;
+
+	// zero padding the impulse response keeps the kernels free of partial vectors, short responses get a specialized kernel
+	kernel.size = (irSize + 15) & ~15U;
 
-	// limit the size we use to what we can put in the buffer
-	unsigned int clippedIRSize = std::min(ir->getSize(), static_cast<unsigned int>(MaxSize));
+	for (auto fixedSize : DSPKernels::FixedFIRSizes)
+	{
+		if (kernel.size <= fixedSize)
+		{
+			if (fixedSize - kernel.size <= MaxFixedFIRPadding) kernel.size = fixedSize;
+			break;
+		}
+	}
+
+	for (int c : {0, 1})
+	{
+		auto buffer = ir.getChannel(c);
+
+		// leading zeros of the reversed impulse response correspond to the zero padded tail
+		kernel.reversedIR[c].resize(kernel.size, 0.f);
+		std::reverse_copy(buffer, buffer + irSize, kernel.reversedIR[c].begin() + (kernel.size - irSize));
+
+		kernel.history[c].resize(kernel.size - 1 + BlockSize, 0.f);
+	}
 
-	// resize the buffer and shrink to fit
-	this->bufferL.setLengthAndResize(clippedIRSize);
-	this->bufferR.setLengthAndResize(clippedIRSize);
+	return kernel;
 }
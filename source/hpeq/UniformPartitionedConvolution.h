@@ -0,0 +1,284 @@
+#pragma once
+
+#include "ASyncedConvolutionEngine.h"
+#include "PartitionedKernel.h"
+#include <algorithm>
+
+
+/**
+	UniformPartitionedConvolution implements the block scheduling shared by the uniformly partitioned FFT engines, #FFTConvolution
+	and #FFTPartConvolution, on a #UniformPartitionedKernel or a kernel derived from it.
+
+	The input is queued until a partition is complete while the output is read from the overlap add accumulator. A complete
+	partition is either convolved at once, see #performConvolution, or with #setLoadBalancing by the balanced scheduling in
+	#UniformPartitionedKernel::NumStages stages spread over the next partition period.
+	The engines only implement the partition size and the parts of a stage that differ, see #onInputStage and #onOutputStage.
+*/
+template<typename Kernel>
+class UniformPartitionedConvolution : public ASyncedConvolutionEngine<Kernel>
+{
+public:
+	// Inherited via AConvolutionEngine
+	virtual void process(const float * readL, const float * readR, float * writeL, float * writeR, unsigned int numSamples) override;
+
+	/**
+		Enables the balanced scheduling: the FFTs and multiply accumulates of a block are spread evenly over the host callbacks
+		of the next partition period instead of running in a single callback, see #UniformPartitionedKernel::balanced.
+		The FFTs are not split, a callback still runs at least one full transform. Adds one partition of latency.
+		@param enabled true to spread the work
+	*/
+	void setLoadBalancing(bool enabled);
+
+	/**
+		Processes one channel on a worker thread while the audio thread processes the other, see #ForkJoinPool.
+		The worker spins while audio is running and keeps a core busy, it parks once the callbacks stop. Has no effect on
+		single core machines or together with load balancing.
+		@param enabled true to process the channels in parallel
+	*/
+	void setParallelChannels(bool enabled);
+
+	/**
+		Returns the partition size, doubled with load balancing.
+	*/
+	virtual unsigned int getLatencySamples() const override;
+
+protected:
+
+	// Inherited via ASyncedConvolutionEngine
+	virtual void onDataUpdate() override;
+
+	/**
+		Returns the partition size used for an impulse response of @p irSize samples.
+	*/
+	virtual unsigned int getPartitionSize(unsigned int irSize) const = 0;
+
+	/**
+		Convolves the complete partition in audioInput and overlap adds the result to the output accumulator.
+		The default processes both channels with #UniformPartitionedKernel::forEachChannel.
+	*/
+	virtual void performConvolution(Kernel & kernel);
+
+	/**
+		Called by the balanced scheduling after the FFT stage of a channel, the spectrum of the pending block is in outputFFT.
+	*/
+	virtual void onInputStage(Kernel & /*kernel*/, unsigned int /*channel*/) { }
+
+	/**
+		Called by the balanced scheduling befor the IFFT stage of a channel, once the multiply accumulate of both channels is done.
+	*/
+	virtual void onOutputStage(Kernel & /*kernel*/, unsigned int /*channel*/) { }
+
+	/**
+		Creates the channel worker of a new kernel if parallel channels are enabled. Pre processor only.
+		@param kernel the new kernel
+		@param ir the impulse response of the kernel, for the sample rate
+	*/
+	void prepareChannelWorker(Kernel & kernel, const ImpulseResponse & ir) const;
+
+	bool loadBalancing{ false };
+	bool parallelChannels{ false };
+
+private:
+
+	/**
+		Runs a single stage of the balanced scheduling on the pending block.
+	*/
+	void performStage(Kernel & kernel, unsigned int stage);
+
+	/**
+		Completes the pending block of the balanced scheduling and makes the queued input the next pending block.
+	*/
+	void finishBlock(Kernel & kernel);
+
+	// the number of samples currently stored in the kernels audioInput
+	unsigned int numQueuedSamples{ 0 };
+};
+
+template<typename Kernel>
+inline void UniformPartitionedConvolution<Kernel>::process(const float * readL, const float * readR, float * writeL, float * writeR, unsigned int numSamples)
+{
+	this->updateData();
+
+	auto kernel = this->getData();
+
+	if (kernel->numPartitions == 0)
+	{
+		std::fill(writeL, writeL + numSamples, 0.f);
+		std::fill(writeR, writeR + numSamples, 0.f);
+		return;
+	}
+
+	const float * read[2]  = { readL, readR };
+	float		* write[2] = { writeL, writeR };
+
+	unsigned int i = 0;
+	while (i < numSamples)
+	{
+		// process up to the next fft
+		unsigned int numRunSamples = std::min(numSamples - i, kernel->partSize - numQueuedSamples);
+
+		for (int c : {0, 1})
+		{
+			// cache input in audio working buffer first, input and output buffers might be the same
+			std::copy(read[c] + i, read[c] + i + numRunSamples, &kernel->audioInput[c][numQueuedSamples]);
+
+			// write the output block of the last convolution
+			auto output = kernel->outputAccumulator[c].data();
+			std::copy(output + numQueuedSamples, output + numQueuedSamples + numRunSamples, write[c] + i);
+		}
+
+		numQueuedSamples += numRunSamples;
+		i += numRunSamples;
+
+		if (kernel->balanced)
+		{
+			// keep the stages of the pending block in step with the input
+			unsigned int targetStage = UniformPartitionedKernel::NumStages * numQueuedSamples / kernel->partSize;
+			while (kernel->numStagesDone < targetStage)
+			{
+				performStage(*kernel, kernel->numStagesDone++);
+			}
+
+			if (numQueuedSamples == kernel->partSize)
+			{
+				finishBlock(*kernel);
+			}
+		}
+		// perform fft if we have enough samples
+		else if (numQueuedSamples == kernel->partSize)
+		{
+			performConvolution(*kernel);
+
+			kernel->advance();
+			numQueuedSamples = 0;
+		}
+	}
+}
+
+template<typename Kernel>
+inline void UniformPartitionedConvolution<Kernel>::setLoadBalancing(bool enabled)
+{
+	if (enabled == loadBalancing) return;
+
+	this->loadBalancing = enabled;
+	this->onImpulseResponseUpdate();
+}
+
+template<typename Kernel>
+inline void UniformPartitionedConvolution<Kernel>::setParallelChannels(bool enabled)
+{
+	if (enabled == parallelChannels) return;
+
+	this->parallelChannels = enabled;
+	this->onImpulseResponseUpdate();
+}
+
+template<typename Kernel>
+inline unsigned int UniformPartitionedConvolution<Kernel>::getLatencySamples() const
+{
+	unsigned int partSize = getPartitionSize(this->getImpulseResponse()->getSize());
+
+	// the balanced scheduling finishes a block one partition later
+	return loadBalancing ? 2 * partSize : partSize;
+}
+
+template<typename Kernel>
+inline void UniformPartitionedConvolution<Kernel>::onDataUpdate()
+{
+	// the new kernel comes with an empty delay line and a silent accumulator, only the input has to be restarted
+	numQueuedSamples = 0;
+}
+
+template<typename Kernel>
+inline void UniformPartitionedConvolution<Kernel>::performConvolution(Kernel & kernel)
+{
+	auto processChannel = [&kernel](unsigned int c)
+	{
+		kernel.transformInput(c);
+
+		// per parition complex multiplication
+		kernel.accumulateSpectrum(c, kernel.outputFFT[c].data());
+
+		kernel.transformOutput(c);
+	};
+
+	kernel.forEachChannel(processChannel);
+}
+
+template<typename Kernel>
+inline void UniformPartitionedConvolution<Kernel>::prepareChannelWorker(Kernel & kernel, const ImpulseResponse & ir) const
+{
+	// the balanced scheduling staggers the channels on the audio thread
+	if (!parallelChannels || loadBalancing) return;
+
+	// the channels fork once per partition, in bursts once per host block with partitions smaller than the block
+	unsigned int period = std::max(kernel.partSize, this->getHostBlockSize());
+	kernel.createChannelWorker(period / static_cast<double>(ir.getSampleRate()));
+}
+
+template<typename Kernel>
+inline void UniformPartitionedConvolution<Kernel>::performStage(Kernel & kernel, unsigned int stage)
+{
+	/*
+		The stages of a block, the channels are staggered:
+		- fft left, fft right
+		- the multiply accumulate split in bin ranges, left then right
+		- ifft left, ifft right
+	*/
+
+	const unsigned int NumMACStages = UniformPartitionedKernel::NumMACStages;
+
+	if (stage < 2)
+	{
+		unsigned int c = stage;
+
+		kernel.fft->performRealFFT(kernel.pendingBlock[c].data(), kernel.outputFFT[c].data());
+		kernel.setInputFFT(c, kernel.outputFFT[c].data());
+
+		onInputStage(kernel, c);
+	}
+	else if (stage < 2 + 2 * NumMACStages)
+	{
+		unsigned int c = (stage - 2) / NumMACStages;
+
+		unsigned int firstBin, endBin;
+		kernel.getMACStageRange((stage - 2) % NumMACStages, firstBin, endBin);
+		kernel.accumulateSpectrum(c, kernel.outputFFT[c].data(), firstBin, endBin);
+	}
+	else
+	{
+		unsigned int c = stage - 2 - 2 * NumMACStages;
+
+		onOutputStage(kernel, c);
+
+		// the pending block is reused for the convolution output
+		kernel.fft->performRealIFFT(kernel.outputFFT[c].data(), kernel.pendingBlock[c].data());
+	}
+}
+
+template<typename Kernel>
+inline void UniformPartitionedConvolution<Kernel>::finishBlock(Kernel & kernel)
+{
+	auto partSize = kernel.partSize;
+
+	for (int c : {0, 1})
+	{
+		// overlap add: the first half plus the last tail is the next output block, the second half is the new tail
+		auto output = kernel.outputAccumulator[c].data();
+		auto result = kernel.pendingBlock[c].data();
+
+		for (unsigned int i = 0; i < partSize; i++)
+		{
+			output[i] = result[i] + output[i + partSize];
+			output[i + partSize] = result[i + partSize];
+		}
+
+		// the queued input becomes the next pending block, zero padded
+		std::swap(kernel.audioInput[c], kernel.pendingBlock[c]);
+		std::fill(kernel.pendingBlock[c].begin() + partSize, kernel.pendingBlock[c].end(), 0.f);
+	}
+
+	kernel.advance();
+	kernel.numStagesDone = 0;
+	numQueuedSamples = 0;
+}
@@ -1,7 +1,7 @@
 #include "IRLoader.h"
 #include "../hpeq/IRTools.h"
 
-IRLoader::ErrorCode IRLoader::loadImpulseResponse(juce::File file, unsigned int maxSupportedLength)
+IRLoader::ErrorCode IRLoader::loadImpulseResponse(juce::File file)
 {
 	try
 	{
@@ -22,7 +22,7 @@ IRLoader::ErrorCode IRLoader::loadImpulseResponse(juce::File file, unsigned int
 		auto rSource = (buffer.getNumChannels() > 1) ? 1 : 0;
 		this->loadedIR = ImpulseResponse(buffer.getReadPointer(0), buffer.getReadPointer(rSource), buffer.getNumSamples(), reader->sampleRate);
 		
-		auto err = updateSampleRate(samplerate, maxSupportedLength);
+		auto err = updateSampleRate(samplerate);
 
 		if (err != ErrorCode::NoError) return err;
 
@@ -33,16 +33,11 @@ IRLoader::ErrorCode IRLoader::loadImpulseResponse(juce::File file, unsigned int
 	return ErrorCode::Other;
 }
 
-IRLoader::ErrorCode IRLoader::updateSampleRate(float samplerate, unsigned int maxSupportedLength)
+IRLoader::ErrorCode IRLoader::updateSampleRate(float samplerate)
 {
 	this->samplerate = samplerate;
 	loadedIR = IRTools::resample(loadedIR, samplerate);
 
-	if (loadedIR.getSize() > maxSupportedLength)
-	{
-		loadedIR = ImpulseResponse({ 1 }, { 1 }, samplerate);
-		return ErrorCode::ToLong;
-	}
 	return ErrorCode::NoError;
 }
 
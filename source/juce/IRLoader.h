@@ -16,26 +16,23 @@ public:
 	enum class ErrorCode
 	{
 		NoError = 0, // no error
-		ToLong = 1,	 // impulse response was too long during loading or resampling
 		Other  = 2	 // other errors
 	};
 
 
 	/**
-		Function loads an audio file.
+		Function loads an audio file. The impulse response length is not limited, the convolution engines size their buffers to it.
 		@param file The audio file.
-		@param maxSupportedLength the maximum supported length of the impule response. If the length of the IR in file is longer, loadImpulseResponse will return false and not load the IR.
 		@return The ErrorCode determining if the file could be loaded or why not.
 	*/
-	ErrorCode loadImpulseResponse(juce::File file, unsigned int maxSupportedLength);
+	ErrorCode loadImpulseResponse(juce::File file);
 	
 	/**
-		Function tries to resample the loaded impulse response. It may return an Error if the resulting impulse response would be to long.
+		Function resamples the loaded impulse response.
 		@param samplerate the new sample rate
-		@param maxSupportedLength the maximum supported length of the impule response. If the length of the IR in file is longer, loadImpulseResponse will return false and not load the IR.
-		@return The ErrorCode determining if the impulse response length is valid
+		@return The ErrorCode determining if the impulse response could be resampled
 	*/	
-	ErrorCode updateSampleRate(float samplerate, unsigned int maxSupportedLength);
+	ErrorCode updateSampleRate(float samplerate);
 
 
 
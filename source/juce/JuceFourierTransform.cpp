@@ -1,9 +1,13 @@
 #include "JuceFourierTransform.h"
+#include <cassert>
+#include <cmath>
 
 using namespace juce::dsp;
 
-JuceFourierTransform::JuceFourierTransform(unsigned int order) : AFourierTransform(order), fft(order)
+JuceFourierTransform::JuceFourierTransform(unsigned int order) : AFourierTransform(order), fft(order), halfFFT(order > 0 ? order - 1 : 0)
 {
+	assert(order > 0);
+
 	bufferIn.reserve(getSize());
 	bufferOut.reserve(getSize());
 
@@ -12,6 +16,15 @@ JuceFourierTransform::JuceFourierTransform(unsigned int order) : AFourierTransfo
 		bufferIn.push_back(0);
 		bufferOut.push_back(0);
 	}
+
+	unsigned int halfSize = getSize() / 2;
+
+	realTwiddles.resize(halfSize);
+	for (unsigned int k = 0; k < halfSize; k++)
+	{
+		double phase = -2. * 3.14159265358979323846 * k / getSize();
+		realTwiddles[k] = std::complex<float>(static_cast<float>(std::cos(phase)), static_cast<float>(std::sin(phase)));
+	}
 }
 
 void JuceFourierTransform::performFFT(std::complex<float>* in, std::complex<float>* out)
@@ -74,3 +87,52 @@ void JuceFourierTransform::performIFFTInPlace(std::complex<float>* buffer)
 	}
 }
 
+void JuceFourierTransform::performRealFFT(const float * in, std::complex<float>* out)
+{
+	unsigned int halfSize = getSize() / 2;
+
+	// even samples as real, odd samples as imaginary part
+	for (unsigned int i = 0; i < halfSize; i++)
+	{
+		bufferIn[i] = Complex<float>(in[2 * i], in[2 * i + 1]);
+	}
+
+	halfFFT.perform(bufferIn.data(), bufferOut.data(), false);
+
+	// split into the spectra of the even and odd samples and combine them: X[k] = E[k] + W^k O[k]
+	for (unsigned int k = 0; k <= halfSize; k++)
+	{
+		auto z		  = bufferOut[k == halfSize ? 0 : k];
+		auto mirrored = std::conj(bufferOut[k == 0 ? 0 : halfSize - k]);
+
+		auto even = 0.5f * (z + mirrored);
+		auto odd  = std::complex<float>(0.f, -0.5f) * (z - mirrored);
+
+		// W^halfSize = -1
+		out[k] = (k == halfSize) ? even - odd : even + realTwiddles[k] * odd;
+	}
+}
+
+void JuceFourierTransform::performRealIFFT(const std::complex<float>* in, float * out)
+{
+	unsigned int halfSize = getSize() / 2;
+
+	// recombine the spectra of the even and odd samples: Z[k] = E[k] + i O[k]
+	for (unsigned int k = 0; k < halfSize; k++)
+	{
+		auto mirrored = std::conj(in[halfSize - k]);
+
+		auto even = 0.5f * (in[k] + mirrored);
+		auto odd  = 0.5f * (in[k] - mirrored) * std::conj(realTwiddles[k]);
+
+		bufferIn[k] = even + std::complex<float>(0.f, 1.f) * odd;
+	}
+
+	halfFFT.perform(bufferIn.data(), bufferOut.data(), true);
+
+	for (unsigned int i = 0; i < halfSize; i++)
+	{
+		out[2 * i]	   = bufferOut[i].real();
+		out[2 * i + 1] = bufferOut[i].imag();
+	}
+}
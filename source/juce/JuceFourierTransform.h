@@ -7,6 +7,10 @@
 
 /**
 	A AFourierTransform implementation based on juce's FFT class.
+
+	The real valued transforms run a complex FFT of half the size on the even and odd samples and split the result with
+	precomputed twiddle factors. juce's real only transforms aren't used, their fallback implementation allocates scratch
+	memory on the heap from 2^15 samples on.
 */
 class JuceFourierTransform : public AFourierTransform
 {
@@ -23,11 +27,21 @@ public:
 	virtual void performFFTInPlace(std::complex<float>* buffer) override;
 	virtual void performIFFTInPlace(std::complex<float>* buffer) override;
 
+	// Inherited via AFourierTransform
+	virtual void performRealFFT(const float* in, std::complex<float>* out) override;
+	virtual void performRealIFFT(const std::complex<float>* in, float* out) override;
+
 private:
 
 	juce::dsp::FFT fft;
 
+	// complex FFT of half the size for the real valued transforms
+	juce::dsp::FFT halfFFT;
+
 	std::vector<juce::dsp::Complex<float>> bufferIn;
 	std::vector<juce::dsp::Complex<float>> bufferOut;
 
+	// exp(-2 pi i k / size) for k < size / 2
+	std::vector<std::complex<float>> realTwiddles;
+
 };
\ No newline at end of file
@@ -58,11 +58,16 @@ HpeqAudioProcessorEditor::HpeqAudioProcessorEditor (HpeqAudioProcessor& p)
 	setUpToggleButton(controls.minPhase,	getParameter<AudioParameterBool>("MinPhase"));
 	setUpToggleButton(controls.normalize,	getParameter<AudioParameterBool>("Norm"));
 	setUpToggleButton(controls.monoIR,		getParameter<AudioParameterBool>("Mono"));
+	setUpToggleButton(controls.blockAligned, getParameter<AudioParameterBool>("BlockAligned"));
+	setUpToggleButton(controls.parallelChannels, getParameter<AudioParameterBool>("ParallelChannels"));
+	setUpToggleButton(controls.loadBalancing, getParameter<AudioParameterBool>("LoadBalancing"));
+	setUpToggleButton(controls.backgroundProcessing, getParameter<AudioParameterBool>("BackgroundProcessing"));
 
 	setUpComboBox(controls.lowFade,			getParameter<AudioParameterChoice>("LowFade"));
 	setUpComboBox(controls.highFade,		getParameter<AudioParameterChoice>("HighFade"));
 	setUpComboBox(controls.smooth,			getParameter<AudioParameterChoice>("Smooth"));
 	setUpComboBox(controls.engine,			getParameter<AudioParameterChoice>("Engine"));
+	setUpComboBox(controls.latencyBudget,	getParameter<AudioParameterChoice>("LatencyBudget"));
 
 	setUpComboBox(controls.partitions,		getParameter<AudioParameterInt>("Partitions"));
 
@@ -116,7 +121,12 @@ void HpeqAudioProcessorEditor::resized()
 		&controls.highFade,
 		&controls.smooth,
 		&controls.engine,
+		&controls.latencyBudget,
 		&controls.partitions,
+		&controls.blockAligned,
+		&controls.parallelChannels,
+		&controls.loadBalancing,
+		&controls.backgroundProcessing,
 	};
 
 	const int ctrlBoxOffsetH = 5;
@@ -148,10 +158,6 @@ void HpeqAudioProcessorEditor::displayErrorMessage(ErrorMessageType type)
 		{
 			message = "Impulse Response File could not be loaded.";
 		} break;
-		case ErrorMessageType::IRToLong:
-		{
-			message =  getName().toStdString() + " only supports Impulse Responses with a maximum length of " + std::to_string(ConvMaxSize);
-		} break;
 	}
 	AlertWindow::showMessageBox(AlertWindow::WarningIcon, "Erro", message);
 }
@@ -33,7 +33,6 @@ public:
 
 	enum class ErrorMessageType
 	{
-		IRToLong,
 		IRCouldNotLoad
 	};
 public:
@@ -85,11 +84,16 @@ private:
 		ToggleButton minPhase;
 		ToggleButton normalize;
 		ToggleButton monoIR;
+		ToggleButton blockAligned;
+		ToggleButton parallelChannels;
+		ToggleButton loadBalancing;
+		ToggleButton backgroundProcessing;
 
 		ComboBoxWLabel lowFade;
 		ComboBoxWLabel highFade;
 		ComboBoxWLabel smooth;
 		ComboBoxWLabel engine;
+		ComboBoxWLabel latencyBudget;
 		ComboBoxWLabel partitions;
 
 	} controls;
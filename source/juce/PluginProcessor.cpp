@@ -13,6 +13,28 @@
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
 #include "../hpeq/IRTools.h"
+#include <limits>
+
+
+namespace
+{
+	// Version 1 stores choice parameters by index, so appending choices keeps stored states. Unversioned states
+	// stored all parameters as normalized values.
+	const int StateVersion = 1;
+
+	/**
+		Returns the choices of parameters whose choice list changed since the unversioned state, by parameter ID.
+		Their normalized values are mapped back to a choice name with these lists.
+	*/
+	const std::map<juce::String, juce::StringArray> & getUnversionedChoices()
+	{
+		static const std::map<juce::String, juce::StringArray> choices{
+			{ "Engine", { "Time Domain", "Brute FFT", "Part FFT", "ParFilt" } },
+			{ "Smooth", { "Off", "1/12 Octave", "1/5 Octave", "1/3 Octave", "1 Octave" } } };
+
+		return choices;
+	}
+}
 
 
 
@@ -37,10 +59,15 @@ HpeqAudioProcessor::HpeqAudioProcessor()
 	addParameter(parameters.lowFade		= new AudioParameterChoice("LowFade",	"Low Fade",	 { "Off", "20Hz", "50Hz", "100Hz" },0));
 	addParameter(parameters.highFade	= new AudioParameterChoice("HighFade",	"High Fade", { "Off", "5kHz", "10kHz", "20kHz" }, 0));
 	addParameter(parameters.monoIR		= new AudioParameterBool("Mono",		"Mono IR", 0));
-	addParameter(parameters.smooth		= new AudioParameterChoice("Smooth",	"Smooth", { "Off", "1/12 Octave", "1/5 Octave", "1/3 Octave", "1 Octave" }, 0));
-	addParameter(parameters.engine		= new AudioParameterChoice("Engine", "Engine", { "Time Domain", "Brute FFT", "Part FFT", "ParFilt" }, 0));
+	addParameter(parameters.smooth		= new AudioParameterChoice("Smooth",	"Smooth", { "Off", "1/12 Octave", "1/5 Octave", "1/3 Octave", "1 Octave", "1 ERB", "Variable" }, 0));
+	addParameter(parameters.engine		= new AudioParameterChoice("Engine", "Engine", { "Time Domain", "Brute FFT", "Part FFT", "ParFilt", "Non-Uniform FFT", "Auto" }, 0));
+	addParameter(parameters.latencyBudget = new AudioParameterChoice("LatencyBudget", "Latency Budget", { "0", "64", "256", "1024", "4096", "Unlimited" }, 2));
 
 	addParameter(parameters.partitions	= new AudioParameterInt("Partitions",	"Partitions",0,7,0));
+	addParameter(parameters.blockAligned = new AudioParameterBool("BlockAligned", "Block Aligned Partitions", 0));
+	addParameter(parameters.parallelChannels = new AudioParameterBool("ParallelChannels", "Parallel Channels", 0));
+	addParameter(parameters.loadBalancing = new AudioParameterBool("LoadBalancing", "Load Balancing", 0));
+	addParameter(parameters.backgroundProcessing = new AudioParameterBool("BackgroundProcessing", "Background Processing", 0));
 
 	addParameter(parameters.parFiltWarp  = new AudioParameterFloat("ParFiltWarp", "ParFilt War", 0, 0.9, .50));
 	addParameter(parameters.parFiltIIROrder = new AudioParameterChoice("ParFiltIIROrder", "ParFilt IIR Order", { "16","32", "64", "128" },1));
@@ -55,8 +82,13 @@ HpeqAudioProcessor::HpeqAudioProcessor()
 	parameters.smooth->addListener(this);
 	
 	parameters.engine->addListener(this);
+	parameters.latencyBudget->addListener(this);
 
 	parameters.partitions->addListener(this);
+	parameters.blockAligned->addListener(this);
+	parameters.parallelChannels->addListener(this);
+	parameters.loadBalancing->addListener(this);
+	parameters.backgroundProcessing->addListener(this);
 
 	parameters.parFiltWarp->addListener(this);
 	parameters.parFiltIIROrder->addListener(this);
@@ -73,6 +105,10 @@ HpeqAudioProcessor::HpeqAudioProcessor()
 HpeqAudioProcessor::~HpeqAudioProcessor()
 {
 	joinPreProcessorThread();
+
+	// the calibration stops befor its next measurement
+	cancelCalibration.store(true);
+	if (futureCalibration != nullptr) futureCalibration->wait();
 }
 
 //==============================================================================
@@ -110,7 +146,10 @@ bool HpeqAudioProcessor::isMidiEffect() const
 
 double HpeqAudioProcessor::getTailLengthSeconds() const
 {
-    return 0.0;
+	// before prepareToPlay, a low sample rate errs on the long side
+	double sampleRate = (getSampleRate() > 0) ? getSampleRate() : 44100.0;
+
+	return engineTailSamples.load() / sampleRate;
 }
 
 int HpeqAudioProcessor::getNumPrograms()
@@ -140,16 +179,20 @@ void HpeqAudioProcessor::changeProgramName (int index, const String& newName)
 //==============================================================================
 void HpeqAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
 {
-	auto errorCode = irLoader.updateSampleRate(sampleRate, ConvMaxSize);
+	// engines align their partitions to the new block size with the next pre processor run
+	auto blockSize = static_cast<unsigned int>(std::max(samplesPerBlock, 0));
+	if (hostBlockSize.exchange(blockSize) != blockSize)
+	{
+		triggerAsyncUpdate();
+	}
+
+	auto errorCode = irLoader.updateSampleRate(sampleRate);
 
 	if (errorCode != IRLoader::ErrorCode::NoError)
 	{
 		if (auto editor = dynamic_cast<HpeqAudioProcessorEditor*>(getActiveEditor()))
 		{
-			auto messageCode = (errorCode == IRLoader::ErrorCode::ToLong)
-				? HpeqAudioProcessorEditor::ErrorMessageType::IRToLong
-				: HpeqAudioProcessorEditor::ErrorMessageType::IRCouldNotLoad;
-			editor->displayErrorMessage(messageCode);
+			editor->displayErrorMessage(HpeqAudioProcessorEditor::ErrorMessageType::IRCouldNotLoad);
 		}
 	}
 }
@@ -208,25 +251,19 @@ void HpeqAudioProcessor::processBlock (AudioBuffer<float>& buffer, MidiBuffer& m
 	auto rWrite = buffer.getWritePointer(1);
 
 
-	auto currentEngine = parameters.engine->getCurrentChoiceName();
+	auto numSamples = static_cast<unsigned int>(buffer.getNumSamples());
 
-	if (currentEngine == "Time Domain")
-	{
-		this->tdConvolution.process(lRead, rRead, lWrite, rWrite, buffer.getNumSamples());
-	}
-	else if (currentEngine == "Brute FFT")
-	{
-		this->fftConvolution.process(lRead, rRead, lWrite, rWrite, buffer.getNumSamples());
-	}
-	else if (currentEngine == "Part FFT")
+	// pick up a newly created engine, the old one is freed by the pre processor or timer
+	convolutionEngine.update();
+
+	if (auto engine = convolutionEngine.get())
 	{
-		this->fftPartConvolution.process(lRead, rRead, lWrite, rWrite, buffer.getNumSamples());
+		engine->process(lRead, rRead, lWrite, rWrite, numSamples);
 	}
-	else if (currentEngine == "ParFilt")
+	else
 	{
-		this->parFiltConvolution.process(lRead, rRead, lWrite, rWrite, buffer.getNumSamples());
+		buffer.clear();
 	}
-
 }
 
 //==============================================================================
@@ -245,11 +282,15 @@ void HpeqAudioProcessor::getStateInformation (MemoryBlock& destData)
 {
 	std::unique_ptr<XmlElement> xml = std::unique_ptr<XmlElement>(new XmlElement("State"));
 	xml->setAttribute("IRPath", irFile.getFullPathName());
+	xml->setAttribute("StateVersion", StateVersion);
 
 	for (auto param : getParameters())
 	{
 		auto paramWID = dynamic_cast<AudioProcessorParameterWithID*>(param);
-		if (paramWID) xml->setAttribute(paramWID->paramID, paramWID->getValue());
+		if (!paramWID) continue;
+
+		if (auto choice = dynamic_cast<AudioParameterChoice*>(param))	xml->setAttribute(paramWID->paramID, choice->getIndex());
+		else															xml->setAttribute(paramWID->paramID, paramWID->getValue());
 	}
 	
 	copyXmlToBinary(*xml, destData);
@@ -267,6 +308,8 @@ void HpeqAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
 			if(xmlState->hasAttribute("IRPath") && (xmlState->getStringAttribute("IRPath") != ""))
 				setIRFile(xmlState->getStringAttribute("IRPath"));
 
+			int version = xmlState->getIntAttribute("StateVersion", 0);
+
 			for (int i = 0; i < xmlState->getNumAttributes(); i++)
 			{
 				for (auto param : getParameters())
@@ -277,8 +320,25 @@ void HpeqAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
 					if (paramWID->paramID == xmlState->getAttributeName(i))
 					{						
 						float val = std::atof(xmlState->getAttributeValue(i).toStdString().c_str());
-						paramWID->setValueNotifyingHost(val);
-
+						auto choice = dynamic_cast<AudioParameterChoice*>(param);
+
+						if (choice && version >= 1)
+						{
+							*choice = jlimit(0, choice->choices.size() - 1, roundToInt(val));
+						}
+						else if (choice && getUnversionedChoices().count(paramWID->paramID))
+						{
+							// the choice list changed, look the old choice up by name
+							auto & oldChoices = getUnversionedChoices().at(paramWID->paramID);
+							auto oldIndex = jlimit(0, oldChoices.size() - 1, roundToInt(val * (oldChoices.size() - 1)));
+							auto index = choice->choices.indexOf(oldChoices[oldIndex]);
+
+							if (index >= 0) *choice = index;
+						}
+						else
+						{
+							paramWID->setValueNotifyingHost(val);
+						}
 					}
 				}
 			}
@@ -291,7 +351,7 @@ void HpeqAudioProcessor::setIRFile(juce::File file)
 {
 
 	this->irFile = file;
-	auto errorCode = irLoader.loadImpulseResponse(irFile, ConvMaxSize);
+	auto errorCode = irLoader.loadImpulseResponse(irFile);
 	
 	if (errorCode == IRLoader::ErrorCode::NoError)
 	{
@@ -301,10 +361,7 @@ void HpeqAudioProcessor::setIRFile(juce::File file)
 	{
 		if (auto editor = dynamic_cast<HpeqAudioProcessorEditor*>(getActiveEditor()))
 		{
-			auto messageCode = (errorCode == IRLoader::ErrorCode::ToLong) 
-				? HpeqAudioProcessorEditor::ErrorMessageType::IRToLong 
-				: HpeqAudioProcessorEditor::ErrorMessageType::IRCouldNotLoad;
-			editor->displayErrorMessage(messageCode);
+			editor->displayErrorMessage(HpeqAudioProcessorEditor::ErrorMessageType::IRCouldNotLoad);
 		}
 	}
 }
@@ -342,19 +399,31 @@ void HpeqAudioProcessor::shedulePreProcessAndUpdateIR()
 			{ "10kHz",	10000 },
 			{ "20kHz",	20000} };
 
-		std::map<juce::String, float> smoothValueMap{
-			{ "Off",			0.f },
-			{ "1/12 Octave",	1.f / 12.f },
-			{ "1/5 Octave",		1.f / 5.f },
-			{ "1/3 Octave",		1.f / 3.f },
-			{ "1 Octave",		1.f } };
+		std::map<juce::String, std::pair<IRTools::SmoothingMode, float>> smoothValueMap{
+			{ "Off",			{ IRTools::SmoothingMode::Octave,	0.f } },
+			{ "1/12 Octave",	{ IRTools::SmoothingMode::Octave,	1.f / 12.f } },
+			{ "1/5 Octave",		{ IRTools::SmoothingMode::Octave,	1.f / 5.f } },
+			{ "1/3 Octave",		{ IRTools::SmoothingMode::Octave,	1.f / 3.f } },
+			{ "1 Octave",		{ IRTools::SmoothingMode::Octave,	1.f } },
+			{ "1 ERB",			{ IRTools::SmoothingMode::ERB,		1.f } },
+			{ "Variable",		{ IRTools::SmoothingMode::Variable,	1.f / 3.f } } };
 
 		
 		std::map<juce::String, Engine> engineValueMap {
 			{ "Time Domain",	Engine::TimeDomain},
 			{ "Brute FFT",		Engine::FFTBrute},
 			{ "Part FFT",		Engine::FFTPartitioned},
-			{ "ParFilt",		Engine::ParFilt} };
+			{ "Non-Uniform FFT", Engine::FFTNonUniform},
+			{ "ParFilt",		Engine::ParFilt},
+			{ "Auto",			Engine::Auto} };
+
+		std::map<juce::String, unsigned int> latencyBudgetMap{
+			{ "0",			0 },
+			{ "64",			64 },
+			{ "256",		256 },
+			{ "1024",		1024 },
+			{ "4096",		4096 },
+			{ "Unlimited",	std::numeric_limits<unsigned int>::max() } };
 
 	// get impulse response from file
 	impulseResponse = irLoader.getImpulseResponse();
@@ -367,7 +436,9 @@ void HpeqAudioProcessor::shedulePreProcessAndUpdateIR()
 	cfg.minPhase	= parameters.minPhase->get();
 	cfg.invert		= parameters.invert->get();
 
-	cfg.octaveSmoothWidth = smoothValueMap[parameters.smooth->getCurrentValueAsText()];
+	auto smoothing = smoothValueMap[parameters.smooth->getCurrentValueAsText()];
+	cfg.smoothMode		  = smoothing.first;
+	cfg.octaveSmoothWidth = smoothing.second;
 	cfg.lowFadeFreq		  = lowFadeFreqMap[parameters.lowFade->getCurrentValueAsText()];
 	cfg.highFadeFreq	  = highFadeFreqMap[parameters.highFade->getCurrentValueAsText()];
 	
@@ -375,6 +446,7 @@ void HpeqAudioProcessor::shedulePreProcessAndUpdateIR()
 	cfg.highFade = cfg.highFadeFreq	!= 0;
 
 	cfg.engine = engineValueMap[parameters.engine->getCurrentValueAsText()];
+	cfg.latencyBudget = latencyBudgetMap[parameters.latencyBudget->getCurrentValueAsText()];
 
 	cfg.parFiltFIROrder = std::atoi(parameters.parFiltFIROrder->getCurrentValueAsText().toStdString().c_str());
 	cfg.parFiltNumSOS = std::atoi(parameters.parFiltIIROrder->getCurrentValueAsText().toStdString().c_str());
@@ -382,6 +454,12 @@ void HpeqAudioProcessor::shedulePreProcessAndUpdateIR()
 	cfg.parFiltWarp  = parameters.parFiltWarp->get();
 
 	cfg.fftPartitions = parameters.partitions->get();
+	cfg.blockAlignedPartitions = parameters.blockAligned->get();
+	cfg.parallelChannels = parameters.parallelChannels->get();
+	cfg.loadBalancing = parameters.loadBalancing->get();
+	cfg.backgroundProcessing = parameters.backgroundProcessing->get();
+
+	cfg.hostBlockSize = hostBlockSize.load();
 	
 	auto input = std::unique_ptr<PreProcessorInput>(new PreProcessorInput);
 	input->cfg = cfg;
@@ -408,6 +486,10 @@ HpeqAudioProcessor::BusyState  HpeqAudioProcessor::checkPreProcessorState()
 			this->impulseResponse = futurePreProcessorOutput->get();
 			futurePreProcessorOutput = nullptr;
 
+			// the engine or its partitioning might have changed, let the host compensate the new latency
+			setLatencySamples(static_cast<int>(engineLatencySamples.load()));
+			updateHostDisplay();
+
 			if (irListener) irListener->setUpdateIR(impulseResponse);
 			
 			busyState = BusyState::Idle;
@@ -452,42 +534,226 @@ ImpulseResponse HpeqAudioProcessor::preProcessAndUpdateIR(ImpulseResponse ir, Pr
 {
 	if (cfg.mono) IRTools::makeMono(ir);
 
-	if (cfg.invert) IRTools::invertMagResponse(ir);
+	// all spectral stages share one FFT / iFFT per channel
+	IRTools::SpectralConfig spectralCfg;
+	spectralCfg.invert		 = cfg.invert;
+	spectralCfg.fHP			 = cfg.lowFadeFreq;
+	spectralCfg.fLP			 = cfg.highFadeFreq;
+	spectralCfg.hpfOrder	 = cfg.lowFade  ? 2 : 0;
+	spectralCfg.lpfOrder	 = cfg.highFade ? 2 : 0;
+	spectralCfg.smoothMode	 = cfg.smoothMode;
+	spectralCfg.smoothWidth	 = cfg.octaveSmoothWidth;
+	spectralCfg.normalize	 = cfg.normalize;
+	spectralCfg.makeMinPhase = cfg.minPhase;
+
+	IRTools::processSpectrum(ir, spectralCfg);
+
+	
+	
+	// the automatic selection resolves to one of the exact engines
+	auto engineType = cfg.engine;
+	EngineCostModel::Choice autoChoice;
 
-	if (cfg.lowFade ||cfg.highFade)
+	if (engineType == Engine::Auto)
 	{
-		IRTools::fadeOut(ir, cfg.lowFadeFreq, cfg.highFadeFreq, cfg.lowFade ? 2 : 0, cfg.highFade ? 2 : 0);
+		autoChoice = selectAutoEngine(ir.getSize(), cfg);
+
+		switch (autoChoice.engine)
+		{
+		case EngineCostModel::EngineType::TimeDomain:	  engineType = Engine::TimeDomain;	   break;
+		case EngineCostModel::EngineType::FFTBrute:		  engineType = Engine::FFTBrute;	   break;
+		case EngineCostModel::EngineType::FFTPartitioned: engineType = Engine::FFTPartitioned; break;
+		case EngineCostModel::EngineType::FFTNonUniform:  engineType = Engine::FFTNonUniform;  break;
+		}
 	}
 
-	if (cfg.octaveSmoothWidth != 0) IRTools::octaveSmooth(ir, cfg.octaveSmoothWidth);
+	// only the selected engine exists. When another engine is selected, a new one is created and
+	// replaces the current engine once it received the impulse response.
+	std::unique_ptr<AConvolutionEngine> newEngine;
+	auto engine = preparedEngine;
 
-	if (cfg.normalize) IRTools::normalize(ir);
+	if ((engine == nullptr) || (engineType != preparedEngineType))
+	{
+		newEngine = createEngine(engineType);
+		engine = newEngine.get();
+	}
 
-	if (cfg.minPhase) IRTools::makeMinPhase(ir);
+	engine->setHostBlockSize(cfg.hostBlockSize);
 
-	
-	
-	parFiltConvolution.setFilterBankSize(cfg.parFiltNumSOS, cfg.parFiltFIROrder);
-	parFiltConvolution.setWarpCoefficient(cfg.parFiltWarp);
+	if (engineType == Engine::FFTBrute)
+	{
+		auto fftConvolution = static_cast<FFTConvolution*>(engine);
+		fftConvolution->setParallelChannels(cfg.parallelChannels);
 
-	// partFilt actually does some heavy analysis. We only notify it about IR change when it's currently active
-	if (cfg.engine == Engine::ParFilt)
+		// doubles the latency, so the automatic selection with its latency budget never balances
+		fftConvolution->setLoadBalancing(cfg.loadBalancing && cfg.engine != Engine::Auto);
+	}
+	else if (engineType == Engine::FFTPartitioned)
 	{
-		parFiltConvolution.setImpulseResponse(ir);
+		auto partConvolution = static_cast<FFTPartConvolution*>(engine);
+		partConvolution->setParallelChannels(cfg.parallelChannels);
+
+		// doesn't change the latency, so the automatic selection gets it as well
+		partConvolution->setBackgroundProcessing(cfg.backgroundProcessing);
+
+		if (cfg.engine == Engine::Auto)
+		{
+			partConvolution->setBlockAlignedPartitioning(false);
+			partConvolution->setLoadBalancing(false);
+			partConvolution->setPartitioningOrder(autoChoice.partitioningOrder);
+		}
+		else
+		{
+			partConvolution->setBlockAlignedPartitioning(cfg.blockAlignedPartitions);
+			partConvolution->setLoadBalancing(cfg.loadBalancing);
+			partConvolution->setPartitioningOrder(cfg.fftPartitions);
+		}
+	}
+	else if (engineType == Engine::ParFilt)
+	{
+		auto parFiltConvolution = static_cast<ParFiltConvolution*>(engine);
+		parFiltConvolution->setFilterBankSize(cfg.parFiltNumSOS, cfg.parFiltFIROrder);
+		parFiltConvolution->setWarpCoefficient(cfg.parFiltWarp);
 	}
-	
-	tdConvolution.setImpulseResponse(ir);
-	fftConvolution.setImpulseResponse(ir);
 
-	fftPartConvolution.setPartitioningOrder(cfg.fftPartitions);
-	fftPartConvolution.setImpulseResponse(ir);
+	engine->setImpulseResponse(ir);
+
+	engineLatencySamples.store(engine->getLatencySamples());
+	engineTailSamples.store(engine->getTailSamples());
+
+	// the audio thread keeps running the old engine until the new one is ready
+	if (newEngine != nullptr)
+	{
+		preparedEngine	   = newEngine.get();
+		preparedEngineType = engineType;
+		convolutionEngine.set(std::move(newEngine));
+	}
 	
 	return ir;
 }
 
+EngineCostModel::Choice HpeqAudioProcessor::selectAutoEngine(unsigned int irSize, const PreProcessorConfig & cfg)
+{
+	// the measurements are kept per machine, the benchmarks only run if there is no calibration for this CPU yet
+	if (!costModel.isCalibrated() || costModel.hasParallelChannels() != cfg.parallelChannels)
+	{
+		EngineCostModel loaded;
+
+		if (loaded.load(getCalibrationFile(cfg.parallelChannels).getFullPathName().toStdString(), cfg.parallelChannels))
+		{
+			costModel = std::move(loaded);
+		}
+		else
+		{
+			// the benchmarks take seconds, until they are done the measurements at hand or the default engine are used
+			calibrationRequested.store(true);
+		}
+	}
+
+	// hosts that didn't call prepareToPlay yet get a typical block size
+	unsigned int blockSize = (cfg.hostBlockSize > 0) ? cfg.hostBlockSize : 512;
+
+	return costModel.select(irSize, blockSize, cfg.latencyBudget);
+}
+
+void HpeqAudioProcessor::checkCalibrationState()
+{
+	using namespace std::chrono;
+
+	// the pre processor owns the cost model while it runs
+	if (futurePreProcessorOutput != nullptr) return;
+
+	if (futureCalibration != nullptr)
+	{
+		if (futureCalibration->wait_for(1us) != std::future_status::ready) return;
+
+		auto calibrated = futureCalibration->get();
+		futureCalibration = nullptr;
+
+		if (calibrated.isCalibrated())
+		{
+			costModel = std::move(calibrated);
+
+			// requests of runs that didn't have the measurements yet, the new run requests again if the setting changed meanwhile
+			calibrationRequested.store(false);
+			shedulePreProcessAndUpdateIR();
+		}
+		return;
+	}
+
+	if (calibrationRequested.exchange(false))
+	{
+		bool parallelChannels = parameters.parallelChannels->get();
+		auto calibrationFile = getCalibrationFile(parallelChannels);
+
+		std::packaged_task<EngineCostModel()> task([this, parallelChannels, calibrationFile]()
+		{
+			EngineCostModel calibrated;
+			calibrated.calibrate(parallelChannels, &cancelCalibration);
+
+			if (calibrated.isCalibrated())
+			{
+				calibrationFile.getParentDirectory().createDirectory();
+				calibrated.save(calibrationFile.getFullPathName().toStdString());
+			}
+
+			return calibrated;
+		});
+
+		futureCalibration = std::unique_ptr<std::future<EngineCostModel>>(new std::future<EngineCostModel>(task.get_future()));
+		std::thread(std::move(task)).detach();
+	}
+}
+
+juce::File HpeqAudioProcessor::getCalibrationFile(bool parallelChannels)
+{
+	return File::getSpecialLocation(File::userApplicationDataDirectory).getChildFile("HPEQ")
+		.getChildFile(parallelChannels ? "EngineCalibrationParallel.txt" : "EngineCalibration.txt");
+}
+
+std::unique_ptr<AConvolutionEngine> HpeqAudioProcessor::createEngine(Engine engineType)
+{
+	switch (engineType)
+	{
+	case Engine::TimeDomain:	 return std::unique_ptr<AConvolutionEngine>(new TimeDomainConvolution());
+	case Engine::FFTBrute:		 return std::unique_ptr<AConvolutionEngine>(new FFTConvolution());
+	case Engine::FFTPartitioned: return std::unique_ptr<AConvolutionEngine>(new FFTPartConvolution());
+	case Engine::FFTNonUniform:	 return std::unique_ptr<AConvolutionEngine>(new FFTNonUniformConvolution());
+	case Engine::ParFilt:		 return std::unique_ptr<AConvolutionEngine>(new ParFiltConvolution());
+	case Engine::Auto:			 break;
+	}
+	return nullptr;
+}
+
 void HpeqAudioProcessor::timerCallback()
 {
+	// free the kernel the engine replaced, otherwise a kernel retired while the pre processor published a newer one
+	// holds it back. The pre processor owns the prepared engine while it runs
+	if ((futurePreProcessorOutput == nullptr) && (preparedEngine != nullptr))
+	{
+		preparedEngine->releaseRetired();
+
+		// blocks output without their late partitions, a new engine starts counting at zero
+		if (preparedEngineType == Engine::FFTPartitioned)
+		{
+			auto numMissedDeadlines = static_cast<FFTPartConvolution*>(preparedEngine)->getNumMissedDeadlines();
+
+			if (numMissedDeadlines < loggedMissedDeadlines) loggedMissedDeadlines = 0;
+
+			if (numMissedDeadlines > loggedMissedDeadlines)
+			{
+				DBG("Late partition worker missed " << (int)(numMissedDeadlines - loggedMissedDeadlines) << " deadlines, "
+					<< (int)numMissedDeadlines << " in total");
+				loggedMissedDeadlines = numMissedDeadlines;
+			}
+		}
+	}
+
+	checkCalibrationState();
 	checkPreProcessorState();
+
+	// free the engine the audio thread replaced
+	convolutionEngine.releaseRetired();
 }
 
 void HpeqAudioProcessor::handleAsyncUpdate()
@@ -9,12 +9,9 @@
 */
 #pragma once
 
-#ifndef ConvMaxSize
-	#define ConvMaxSize 131072
-#endif
-
 #include <mutex>
 #include <future>
+#include <atomic>
 
 #include "../JuceLibraryCode/JuceHeader.h"
 
@@ -23,7 +20,11 @@
 #include "../hpeq/TimeDomainConvolution.h"
 #include "../hpeq/FFTConvolution.h"
 #include "../hpeq/FFTPartConvolution.h"
+#include "../hpeq/FFTNonUniformConvolution.h"
 #include "../hpeq/ParFiltConvolution.h"
+#include "../hpeq/ThreadSyncable.h"
+#include "../hpeq/EngineCostModel.h"
+#include "../hpeq/IRTools.h"
 
 #include "../hpeq/AFourierTransformFactory.h"
 #include "JuceFourierTransform.h"
@@ -63,7 +64,9 @@ public:
 		TimeDomain,
 		FFTBrute,
 		FFTPartitioned,
-		ParFilt
+		FFTNonUniform,
+		ParFilt,
+		Auto
 	};
 
 	enum class BusyState
@@ -86,11 +89,28 @@ public:
 		float lowFadeFreq;
 		float highFadeFreq;
 
+		// smoothing width in octaves or ERBs, depending on the mode
 		float octaveSmoothWidth;
+		IRTools::SmoothingMode smoothMode;
 
 		Engine engine;
 
+		// latency budget of the automatic engine selection in samples
+		unsigned int latencyBudget;
+
 		unsigned int fftPartitions;
+		bool blockAlignedPartitions;
+
+		// process the channels of the FFT engines on the audio thread and a worker thread
+		bool parallelChannels;
+
+		// spread the work of the FFT engines over the callbacks of a block, doubles their latency
+		bool loadBalancing;
+
+		// compute the late partitions of the part FFT engine on a worker thread
+		bool backgroundProcessing;
+
+		unsigned int hostBlockSize;
 
 		float	parFiltWarp;
 		int		parFiltNumSOS;
@@ -165,6 +185,34 @@ private:
 	*/
 	ImpulseResponse preProcessAndUpdateIR(ImpulseResponse ir, PreProcessorConfig cfg);
 
+	/**
+		Creates a new, empty convolution engine. Allocates, should not be called from the audio thread.
+		@param engineType the engine type
+		@return the engine
+	*/
+	static std::unique_ptr<AConvolutionEngine> createEngine(Engine engineType);
+
+	/**
+		Picks the engine with the lowest measured cost within the latency budget. Loads the calibration file of the parallel
+		channels setting if the cost model wasn't measured with it. Without one, it requests a background calibration, see
+		#checkCalibrationState, and picks from the measurements at hand, the default engine if there are none. Pre processor thread only.
+		@param irSize the size of the pre processed impulse response
+		@param cfg the pre processor configuration
+		@return the engine choice
+	*/
+	EngineCostModel::Choice selectAutoEngine(unsigned int irSize, const PreProcessorConfig & cfg);
+
+	/**
+		Starts a requested calibration of the cost model on a background thread. Once it finished, hands the measurements to
+		the pre processor while no pre processor run is pending and shedules a new run with them. Message thread only.
+	*/
+	void checkCalibrationState();
+
+	/**
+		Returns the file the cost model measurements of a parallel channels setting are kept in.
+	*/
+	static juce::File getCalibrationFile(bool parallelChannels);
+
 	/**
 		shedules a new pre processor run with the current parameters and loaded IR
 	*/
@@ -192,15 +240,39 @@ private:
 	juce::File irFile;
 	IRLoader irLoader;
 
-	// convolution engines
-	TimeDomainConvolution<ConvMaxSize>  tdConvolution;
-	FFTConvolution<ConvMaxSize>			fftConvolution;
-	FFTPartConvolution<ConvMaxSize>		fftPartConvolution;
-	ParFiltConvolution					parFiltConvolution;
+	// convolution engine used by the audio thread. Engines are created by the pre processor when selected
+	// and handed over wait free, the engine they replace is freed off the audio thread.
+	ThreadSyncable<AConvolutionEngine> convolutionEngine{ nullptr };
+
+	// the engine last handed to the audio thread and its type, accessed by the pre processor. The timer only frees
+	// the retired kernel of the engine while no pre processor run is pending
+	AConvolutionEngine * preparedEngine{ nullptr };
+	Engine preparedEngineType{ Engine::TimeDomain };
+
+	// missed deadlines of the late partition worker of the prepared engine already logged by the timer
+	unsigned int loggedMissedDeadlines{ 0 };
+
+	// measured engine costs for the automatic engine selection, loaded by the pre processor or handed over by the timer
+	// when a background calibration finished
+	EngineCostModel costModel;
+
+	// set by the pre processor when there are no measurements for its parallel channels setting
+	std::atomic<bool> calibrationRequested{ false };
+
+	// the running background calibration, stopped early when the processor is destroyed
+	std::unique_ptr<std::future<EngineCostModel>> futureCalibration;
+	std::atomic<bool> cancelCalibration{ false };
 
 	// current impulse response
 	ImpulseResponse impulseResponse;
 
+	// maximum block size announced by prepareToPlay, 0 until the host prepared the processor
+	std::atomic<unsigned int> hostBlockSize{ 0 };
+
+	// latency and tail of the engine last prepared, written by the pre processor and reported to the host when it finished
+	std::atomic<unsigned int> engineLatencySamples{ 0 };
+	std::atomic<unsigned int> engineTailSamples{ 0 };
+
 	// we use this to store configurations for the pre processing until we can start a new thread.
 	// A note: we could either just use a PreProcessorConfig together with a bool that tells us if the conf has changed 
 	// or we could std::optional (C++17) that would do the same. Dynamic allocation is unnecessary
@@ -222,8 +294,13 @@ private:
 		juce::AudioParameterBool	*minPhase;
 
 		juce::AudioParameterChoice *engine;
+		juce::AudioParameterChoice *latencyBudget;
 
 		juce::AudioParameterInt * partitions;
+		juce::AudioParameterBool * blockAligned;
+		juce::AudioParameterBool * parallelChannels;
+		juce::AudioParameterBool * loadBalancing;
+		juce::AudioParameterBool * backgroundProcessing;
 
 		juce::AudioParameterFloat  * parFiltWarp;
 		juce::AudioParameterChoice  * parFiltIIROrder;